@@ -42,6 +42,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <functional>
+#include <limits>
 #include <memory> // only to support hash of smart pointers
 #include <stdexcept>
 #include <string>
@@ -183,6 +184,25 @@ static Counts& counts() {
 #    define ROBIN_HOOD_UNLIKELY(condition) __builtin_expect(condition, 0)
 #endif
 
+// prefetch
+#if defined(ROBIN_HOOD_DISABLE_INTRINSICS)
+#    define ROBIN_HOOD_PREFETCH(ptr) static_cast<void>(ptr)
+#elif defined(_MSC_VER)
+#    include <intrin.h>
+#    define ROBIN_HOOD_PREFETCH(ptr) _mm_prefetch(reinterpret_cast<char const*>(ptr), _MM_HINT_T0)
+#else
+#    define ROBIN_HOOD_PREFETCH(ptr) __builtin_prefetch(ptr)
+#endif
+
+// SSE2, used to match the control bytes of a group at once in SwissTable
+#if !defined(ROBIN_HOOD_DISABLE_INTRINSICS) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#    include <emmintrin.h>
+#    define ROBIN_HOOD_PRIVATE_DEFINITION_HAS_SSE2() 1
+#else
+#    define ROBIN_HOOD_PRIVATE_DEFINITION_HAS_SSE2() 0
+#endif
+
 // detect if native wchar_t type is availiable in MSVC
 #ifdef _MSC_VER
 #    ifdef _NATIVE_WCHAR_T_DEFINED
@@ -328,6 +348,18 @@ using index_sequence_for = make_index_sequence<sizeof...(T)>;
 
 #endif
 
+// Default allocator of the tables and node pools, which take raw bytes from it. Other allocators
+// need the same two functions, e.g. to place maps on huge pages or in an arena. They are copied
+// with the maps that use them, and moved with their memory.
+struct MallocAllocator {
+    void* allocate(size_t numBytes) noexcept {
+        return std::malloc(numBytes);
+    }
+    void deallocate(void* ptr, size_t ROBIN_HOOD_UNUSED(numBytes) /*unused*/) noexcept {
+        std::free(ptr);
+    }
+};
+
 namespace detail {
 
 // make sure we static_cast to the correct type for hash_int
@@ -389,19 +421,25 @@ inline T unaligned_load(void const* ptr) noexcept {
 
 // Allocates bulks of memory for objects of type T. This deallocates the memory in the destructor,
 // and keeps a linked list of the allocated memory around. Overhead per allocation is the size of a
-// pointer.
-template <typename T, size_t MinNumAllocs = 4, size_t MaxNumAllocs = 256>
-class BulkPoolAllocator {
+// pointer. Blocks are taken from Allocator, which is copied with the pool and moved with it.
+template <typename T, size_t MinNumAllocs = 4, size_t MaxNumAllocs = 256,
+          typename Allocator = MallocAllocator>
+class BulkPoolAllocator : public Allocator {
 public:
     BulkPoolAllocator() noexcept = default;
 
+    explicit BulkPoolAllocator(const Allocator& alloc) noexcept
+        : Allocator(alloc) {}
+
     // does not copy anything, just creates a new allocator.
-    BulkPoolAllocator(const BulkPoolAllocator& ROBIN_HOOD_UNUSED(o) /*unused*/) noexcept
-        : mHead(nullptr)
+    BulkPoolAllocator(const BulkPoolAllocator& o) noexcept
+        : Allocator(static_cast<const Allocator&>(o))
+        , mHead(nullptr)
         , mListForFree(nullptr) {}
 
     BulkPoolAllocator(BulkPoolAllocator&& o) noexcept
-        : mHead(o.mHead)
+        : Allocator(std::move(static_cast<Allocator&>(o)))
+        , mHead(o.mHead)
         , mListForFree(o.mListForFree) {
         o.mListForFree = nullptr;
         o.mHead = nullptr;
@@ -409,6 +447,7 @@ public:
 
     BulkPoolAllocator& operator=(BulkPoolAllocator&& o) noexcept {
         reset();
+        Allocator::operator=(std::move(static_cast<Allocator&>(o)));
         mHead = o.mHead;
         mListForFree = o.mListForFree;
         o.mListForFree = nullptr;
@@ -431,7 +470,10 @@ public:
     void reset() noexcept {
         while (mListForFree) {
             T* tmp = *mListForFree;
-            std::free(mListForFree);
+            size_t numBytes{};
+            std::memcpy(&numBytes, reinterpret_cast<char*>(mListForFree) + sizeof(T**),
+                        sizeof(numBytes));
+            Allocator::deallocate(mListForFree, numBytes);
             mListForFree = reinterpret_cast_no_cast_align_warning<T**>(tmp);
         }
         mHead = nullptr;
@@ -459,21 +501,22 @@ public:
         mHead = obj;
     }
 
-    // Adds an already allocated block of memory to the allocator. This allocator is from now on
-    // responsible for freeing the data (with free()). If the provided data is not large enough to
-    // make use of, it is immediately freed. Otherwise it is reused and freed in the destructor.
+    // Adds a block of memory taken from Allocator to the pool. This pool is from now on
+    // responsible for deallocating it. If the provided data is not large enough to make use of, it
+    // is immediately deallocated. Otherwise it is reused and deallocated in the destructor.
     void addOrFree(void* ptr, const size_t numBytes) noexcept {
         // calculate number of available elements in ptr
-        if (numBytes < ALIGNMENT + ALIGNED_SIZE) {
+        if (numBytes < HEADER_SIZE + ALIGNED_SIZE) {
             // not enough data for at least one element. Free and return.
-            std::free(ptr);
+            Allocator::deallocate(ptr, numBytes);
         } else {
             add(ptr, numBytes);
         }
     }
 
-    void swap(BulkPoolAllocator<T, MinNumAllocs, MaxNumAllocs>& other) noexcept {
+    void swap(BulkPoolAllocator<T, MinNumAllocs, MaxNumAllocs, Allocator>& other) noexcept {
         using std::swap;
+        swap(static_cast<Allocator&>(*this), static_cast<Allocator&>(other));
         swap(mHead, other.mHead);
         swap(mListForFree, other.mListForFree);
     }
@@ -496,20 +539,21 @@ private:
         return numAllocs;
     }
 
-    // WARNING: Underflow if numBytes < ALIGNMENT! This is guarded in addOrFree().
+    // WARNING: Underflow if numBytes < HEADER_SIZE! This is guarded in addOrFree().
     void add(void* ptr, const size_t numBytes) noexcept {
-        const size_t numElements = (numBytes - ALIGNMENT) / ALIGNED_SIZE;
+        const size_t numElements = (numBytes - HEADER_SIZE) / ALIGNED_SIZE;
 
         auto data = reinterpret_cast<T**>(ptr);
 
-        // link free list
+        // link free list, and keep the size of the block for deallocate
         auto x = reinterpret_cast<T***>(data);
         *x = mListForFree;
         mListForFree = data;
+        std::memcpy(static_cast<char*>(ptr) + sizeof(T**), &numBytes, sizeof(numBytes));
 
         // create linked list for newly allocated data
         auto* const headT =
-            reinterpret_cast_no_cast_align_warning<T*>(reinterpret_cast<char*>(ptr) + ALIGNMENT);
+            reinterpret_cast_no_cast_align_warning<T*>(reinterpret_cast<char*>(ptr) + HEADER_SIZE);
 
         auto* const head = reinterpret_cast<char*>(headT);
 
@@ -530,10 +574,9 @@ private:
     ROBIN_HOOD(NOINLINE) T* performAllocation() {
         size_t const numElementsToAlloc = calcNumElementsToAlloc();
 
-        // alloc new memory: [prev |T, T, ... T]
-        // std::cout << (sizeof(T*) + ALIGNED_SIZE * numElementsToAlloc) << " bytes" << std::endl;
-        size_t const bytes = ALIGNMENT + ALIGNED_SIZE * numElementsToAlloc;
-        add(assertNotNull<std::bad_alloc>(std::malloc(bytes)), bytes);
+        // alloc new memory: [prev, size |T, T, ... T]
+        size_t const bytes = HEADER_SIZE + ALIGNED_SIZE * numElementsToAlloc;
+        add(assertNotNull<std::bad_alloc>(Allocator::allocate(bytes)), bytes);
         return mHead;
     }
 
@@ -550,6 +593,10 @@ private:
 
     static constexpr size_t ALIGNED_SIZE = ((sizeof(T) - 1) / ALIGNMENT + 1) * ALIGNMENT;
 
+    // each block starts with the pointer to the next block and its size in bytes
+    static constexpr size_t HEADER_SIZE =
+        ((sizeof(T**) + sizeof(size_t) - 1) / ALIGNMENT + 1) * ALIGNMENT;
+
     static_assert(MinNumAllocs >= 1, "MinNumAllocs");
     static_assert(MaxNumAllocs >= MinNumAllocs, "MaxNumAllocs");
     static_assert(ALIGNED_SIZE >= sizeof(T*), "ALIGNED_SIZE");
@@ -560,21 +607,55 @@ private:
     T** mListForFree{nullptr};
 };
 
-template <typename T, size_t MinSize, size_t MaxSize, bool IsFlat>
+template <typename T, size_t MinSize, size_t MaxSize, bool IsFlat, typename Allocator>
 struct NodeAllocator;
 
-// dummy allocator that does nothing
-template <typename T, size_t MinSize, size_t MaxSize>
-struct NodeAllocator<T, MinSize, MaxSize, true> {
+// dummy allocator that does nothing but keep the Allocator for the table
+template <typename T, size_t MinSize, size_t MaxSize, typename Allocator>
+struct NodeAllocator<T, MinSize, MaxSize, true, Allocator> : public Allocator {
+    NodeAllocator() noexcept = default;
+    explicit NodeAllocator(const Allocator& alloc) noexcept
+        : Allocator(alloc) {}
+    NodeAllocator(const NodeAllocator&) = default;
+    NodeAllocator(NodeAllocator&&) = default;
+    NodeAllocator& operator=(NodeAllocator&&) = default;
+
+    // Like BulkPoolAllocator, copy assignment keeps this Allocator, since the table keeps the
+    // data it allocated when the sizes match and frees it later through this Allocator.
+    NodeAllocator&
+    // NOLINTNEXTLINE(bugprone-unhandled-self-assignment,cert-oop54-cpp)
+    operator=(const NodeAllocator& ROBIN_HOOD_UNUSED(o) /*unused*/) noexcept {
+        return *this;
+    }
 
     // we are not using the data, so just free it.
-    void addOrFree(void* ptr, size_t ROBIN_HOOD_UNUSED(numBytes) /*unused*/) noexcept {
-        std::free(ptr);
+    void addOrFree(void* ptr, size_t numBytes) noexcept {
+        Allocator::deallocate(ptr, numBytes);
     }
 };
 
-template <typename T, size_t MinSize, size_t MaxSize>
-struct NodeAllocator<T, MinSize, MaxSize, false> : public BulkPoolAllocator<T, MinSize, MaxSize> {};
+template <typename T, size_t MinSize, size_t MaxSize, typename Allocator>
+struct NodeAllocator<T, MinSize, MaxSize, false, Allocator>
+    : public BulkPoolAllocator<T, MinSize, MaxSize, Allocator> {
+    NodeAllocator() noexcept = default;
+    explicit NodeAllocator(const Allocator& alloc) noexcept
+        : BulkPoolAllocator<T, MinSize, MaxSize, Allocator>(alloc) {}
+};
+
+// Allocates numBytes of zeroed memory. calloc can skip zeroing fresh pages of the OS.
+inline void* allocateZeroed(MallocAllocator& ROBIN_HOOD_UNUSED(alloc) /*unused*/,
+                            size_t numBytes) noexcept {
+    return std::calloc(1, numBytes);
+}
+
+template <typename Allocator>
+void* allocateZeroed(Allocator& alloc, size_t numBytes) {
+    void* ptr = alloc.allocate(numBytes);
+    if (ptr != nullptr) {
+        std::memset(ptr, 0, numBytes);
+    }
+    return ptr;
+}
 
 // dummy hash, unsed as mixer when robin_hood::hash is already used
 template <typename T>
@@ -1108,8 +1189,82 @@ ROBIN_HOOD_HASH_INT(unsigned long long);
 #if defined(__GNUC__) && !defined(__clang__)
 #    pragma GCC diagnostic pop
 #endif
+
+// Runtime statistics of a map, returned by stats(). Useful to detect bad hash distributions,
+// which show up as long probe distances well before they cause an overflow.
+struct TableStats {
+    // Info bytes hold the distance plus one in multiples of mInfoInc, which is at least 2, so
+    // distances are always below this.
+    static constexpr size_t MaxProbeDistance = 128;
+
+    size_t numElements = 0;
+    size_t numBuckets = 0;
+    float loadFactor = 0;
+    float maxLoadFactor = 0;
+    float growthFactor = 0;
+    // Elements that fit before the next increase_size(). 0 after an info byte overflow.
+    size_t maxNumElementsAllowed = 0;
+    // Times the info bits were halved to make room for longer distances.
+    size_t numInfoIncreases = 0;
+    // Times the table was reallocated and all elements reinserted.
+    size_t numRehashes = 0;
+    // Bytes of the node and info array. Node maps also count the live nodes, but not the
+    // unused nodes of their pool.
+    size_t numBytes = 0;
+    // Number of elements at each distance from their home bucket.
+    size_t probeHistogram[MaxProbeDistance] = {};
+
+    ROBIN_HOOD(NODISCARD) size_t maxProbeDistance() const noexcept {
+        size_t maxDistance = 0;
+        for (size_t d = 0; d < MaxProbeDistance; ++d) {
+            if (probeHistogram[d] != 0) {
+                maxDistance = d;
+            }
+        }
+        return maxDistance;
+    }
+
+    ROBIN_HOOD(NODISCARD) double meanProbeDistance() const noexcept {
+        size_t sum = 0;
+        for (size_t d = 0; d < MaxProbeDistance; ++d) {
+            sum += d * probeHistogram[d];
+        }
+        return numElements == 0 ? 0.0
+                                : static_cast<double>(sum) / static_cast<double>(numElements);
+    }
+};
+
 namespace detail {
 
+// Header of the snapshots written by Table::writeSnapshot() and read by mapped_flat_map. It is
+// followed by the node array and the info bytes, laid out as in the table.
+struct SnapshotHeader {
+    static constexpr uint64_t Magic = UINT64_C(0x70616e73646f6f68); // "hoodsnap" little endian
+    static constexpr uint32_t Version = 1;
+
+    uint64_t magic = Magic;
+    uint32_t version = Version;
+    uint32_t sizeOfSizeT = sizeof(size_t);
+    uint32_t sizeOfValue = 0;
+    uint32_t alignOfValue = 0;
+    uint32_t infoInc = 0;
+    uint32_t infoHashShift = 0;
+    uint64_t numElements = 0;
+    uint64_t numBuckets = 0; // 0 if nothing was allocated
+    uint64_t numElementsWithBuffer = 0;
+    // Hash of the first stored key, to detect a different hash function, e.g. when robin_hood's
+    // hash_int uses crc32 on the writer but not on the reader.
+    uint64_t hashCheck = 0;
+    uint64_t nodesOffset = 0;
+    uint64_t infoOffset = 0;
+    uint64_t size = 0; // total bytes
+
+    // Nodes start after the header, aligned for the node type.
+    static constexpr size_t calcNodesOffset(size_t alignment) noexcept {
+        return (sizeof(SnapshotHeader) + alignment - 1) / alignment * alignment;
+    }
+};
+
 template <typename T>
 struct void_type {
     using type = void;
@@ -1164,8 +1319,11 @@ struct WrapKeyEqual : public T {
 // According to STL, order of templates has effect on throughput. That's why I've moved the
 // boolean to the front.
 // https://www.reddit.com/r/cpp/comments/ahp6iu/compile_time_binary_size_reductions_and_cs_future/eeguck4/
+//
+// Allocator provides the memory of the node and info array, and of the node pool of node maps. See
+// MallocAllocator for the interface.
 template <bool IsFlat, size_t MaxLoadFactor100, typename Key, typename T, typename Hash,
-          typename KeyEqual>
+          typename KeyEqual, typename Allocator = MallocAllocator>
 class Table
     : public WrapHash<Hash>,
       public WrapKeyEqual<KeyEqual>,
@@ -1173,7 +1331,7 @@ class Table
           typename std::conditional<
               std::is_void<T>::value, Key,
               robin_hood::pair<typename std::conditional<IsFlat, Key, Key const>::type, T>>::type,
-          4, 16384, IsFlat> {
+          4, 16384, IsFlat, Allocator> {
 public:
     static constexpr bool is_flat = IsFlat;
     static constexpr bool is_map = !std::is_void<T>::value;
@@ -1189,7 +1347,9 @@ public:
     using size_type = size_t;
     using hasher = Hash;
     using key_equal = KeyEqual;
-    using Self = Table<IsFlat, MaxLoadFactor100, key_type, mapped_type, hasher, key_equal>;
+    using allocator_type = Allocator;
+    using Self =
+        Table<IsFlat, MaxLoadFactor100, key_type, mapped_type, hasher, key_equal, allocator_type>;
 
 private:
     static_assert(MaxLoadFactor100 > 10 && MaxLoadFactor100 < 100,
@@ -1206,7 +1366,13 @@ private:
     static constexpr uint8_t InitialInfoInc = 1U << InitialInfoNumBits;
     static constexpr size_t InfoMask = InitialInfoInc - 1U;
     static constexpr uint8_t InitialInfoHashShift = 0;
-    using DataPool = detail::NodeAllocator<value_type, 4, 16384, IsFlat>;
+    // keyToIdx maps the lower 32 bits of the hash to a bucket, so any bucket above 2^32 could
+    // never be the home of a key.
+    static constexpr uint64_t MaxNumBuckets = static_cast<uint64_t>(1) << 32U;
+    using DataPool = detail::NodeAllocator<value_type, 4, 16384, IsFlat, Allocator>;
+
+    // number of keys hashed and prefetched at once by find_batch
+    static constexpr size_t FindBatchSize = 16;
 
     // type needs to be wider than uint8_t.
     using InfoType = uint32_t;
@@ -1594,18 +1760,16 @@ private:
 #endif
         }
 
-        friend class Table<IsFlat, MaxLoadFactor100, key_type, mapped_type, hasher, key_equal>;
+        friend class Table<IsFlat, MaxLoadFactor100, key_type, mapped_type, hasher, key_equal,
+                           allocator_type>;
         NodePtr mKeyVals{nullptr};
         uint8_t const* mInfo{nullptr};
     };
 
     ////////////////////////////////////////////////////////////////////
 
-    // highly performance relevant code.
-    // Lower bits are used for indexing into the array (2^n size)
-    // The upper 1-5 bits need to be a reasonable good hash, to save comparisons.
     template <typename HashKey>
-    void keyToIdx(HashKey&& key, size_t* idx, InfoType* info) const {
+    ROBIN_HOOD(NODISCARD) size_t hashKey(HashKey&& key) const {
         // for a user-specified hash that is *not* robin_hood::hash, apply robin_hood::hash as
         // an additional mixing step. This serves as a bad hash prevention, if the given data is
         // badly mixed.
@@ -1613,11 +1777,22 @@ private:
             typename std::conditional<std::is_same<::robin_hood::hash<key_type>, hasher>::value,
                                       ::robin_hood::detail::identity_hash<size_t>,
                                       ::robin_hood::hash<size_t>>::type;
+        return Mix{}(WHash::operator()(key));
+    }
 
-        // the lower InitialInfoNumBits are reserved for info.
-        auto h = Mix{}(WHash::operator()(key));
+    // highly performance relevant code.
+    // The lower 32 bits of the hash select the bucket, the lowest 5 bits of them need to be a
+    // reasonable good hash, to save comparisons.
+    template <typename HashKey>
+    void keyToIdx(HashKey&& key, size_t* idx, InfoType* info) const {
+        // the lower InitialInfoNumBits are reserved for info. The bucket is a multiply-shift of
+        // the lower 32 bits (lemire's fastrange), which maps to any number of buckets, not just
+        // powers of two, and takes the top bits of the 32, far from the info bits.
+        auto h = hashKey(key);
         *info = mInfoInc + static_cast<InfoType>((h & InfoMask) >> mInfoHashShift);
-        *idx = (h >> InitialInfoNumBits) & mMask;
+        *idx = static_cast<size_t>(
+            (static_cast<uint64_t>(static_cast<uint32_t>(h)) * static_cast<uint64_t>(mMask + 1)) >>
+            32U);
     }
 
     // forwards the index by one, wrapping around at the end
@@ -1681,7 +1856,13 @@ private:
         size_t idx{};
         InfoType info{};
         keyToIdx(key, &idx, &info);
+        return findIdx(key, idx, info);
+    }
 
+    // probes for key, starting at idx/info as computed by keyToIdx.
+    template <typename Other>
+    ROBIN_HOOD(NODISCARD)
+    size_t findIdx(Other const& key, size_t idx, InfoType info) const {
         do {
             // unrolling this twice gives a bit of a speedup. More unrolling did not help.
             if (info == mInfo[idx] &&
@@ -1702,6 +1883,26 @@ private:
                                 mKeyVals, reinterpret_cast_no_cast_align_warning<Node*>(mInfo)));
     }
 
+    // Calls func(i, idx) with the result of findIdx for each of the numKeys keys. Keys are
+    // processed in groups: all keys of a group are hashed and their buckets prefetched before
+    // any of them is probed, so that the cache misses of independent lookups overlap.
+    template <typename Func>
+    void findIdxBatch(key_type const* keys, size_t numKeys, Func&& func) const {
+        size_t idxs[FindBatchSize];
+        InfoType infos[FindBatchSize];
+        for (size_t first = 0; first < numKeys; first += FindBatchSize) {
+            auto const count = numKeys - first < FindBatchSize ? numKeys - first : FindBatchSize;
+            for (size_t i = 0; i < count; ++i) {
+                keyToIdx(keys[first + i], &idxs[i], &infos[i]);
+                ROBIN_HOOD_PREFETCH(mInfo + idxs[i]);
+                ROBIN_HOOD_PREFETCH(mKeyVals + idxs[i]);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                func(first + i, findIdx(keys[first + i], idxs[i], infos[i]));
+            }
+        }
+    }
+
     void cloneData(const Table& o) {
         Cloner<Table, IsFlat && ROBIN_HOOD_IS_TRIVIALLY_COPYABLE(Node)>()(o, *this);
     }
@@ -1763,35 +1964,52 @@ public:
     // standard, but we can ignore it.
     explicit Table(
         size_t ROBIN_HOOD_UNUSED(bucket_count) /*unused*/ = 0, const Hash& h = Hash{},
-        const KeyEqual& equal = KeyEqual{}) noexcept(noexcept(Hash(h)) && noexcept(KeyEqual(equal)))
+        const KeyEqual& equal = KeyEqual{},
+        const Allocator& alloc = Allocator{}) noexcept(noexcept(Hash(h)) &&
+                                                       noexcept(KeyEqual(equal)))
         : WHash(h)
-        , WKeyEqual(equal) {
+        , WKeyEqual(equal)
+        , DataPool(alloc) {
+        ROBIN_HOOD_TRACE(this)
+    }
+
+    explicit Table(const Allocator& alloc) noexcept(noexcept(Hash()) && noexcept(KeyEqual()))
+        : DataPool(alloc) {
         ROBIN_HOOD_TRACE(this)
     }
 
     template <typename Iter>
     Table(Iter first, Iter last, size_t ROBIN_HOOD_UNUSED(bucket_count) /*unused*/ = 0,
-          const Hash& h = Hash{}, const KeyEqual& equal = KeyEqual{})
+          const Hash& h = Hash{}, const KeyEqual& equal = KeyEqual{},
+          const Allocator& alloc = Allocator{})
         : WHash(h)
-        , WKeyEqual(equal) {
+        , WKeyEqual(equal)
+        , DataPool(alloc) {
         ROBIN_HOOD_TRACE(this)
         insert(first, last);
     }
 
     Table(std::initializer_list<value_type> initlist,
           size_t ROBIN_HOOD_UNUSED(bucket_count) /*unused*/ = 0, const Hash& h = Hash{},
-          const KeyEqual& equal = KeyEqual{})
+          const KeyEqual& equal = KeyEqual{}, const Allocator& alloc = Allocator{})
         : WHash(h)
-        , WKeyEqual(equal) {
+        , WKeyEqual(equal)
+        , DataPool(alloc) {
         ROBIN_HOOD_TRACE(this)
         insert(initlist.begin(), initlist.end());
     }
 
+    allocator_type get_allocator() const noexcept {
+        return static_cast<const Allocator&>(*this);
+    }
+
     Table(Table&& o) noexcept
         : WHash(std::move(static_cast<WHash&>(o)))
         , WKeyEqual(std::move(static_cast<WKeyEqual&>(o)))
         , DataPool(std::move(static_cast<DataPool&>(o))) {
         ROBIN_HOOD_TRACE(this)
+        mMaxLoadFactor100 = o.mMaxLoadFactor100;
+        mGrowthFactor100 = o.mGrowthFactor100;
         if (o.mMask) {
             mKeyVals = std::move(o.mKeyVals);
             mInfo = std::move(o.mInfo);
@@ -1800,6 +2018,8 @@ public:
             mMaxNumElementsAllowed = std::move(o.mMaxNumElementsAllowed);
             mInfoInc = std::move(o.mInfoInc);
             mInfoHashShift = std::move(o.mInfoHashShift);
+            mNumInfoIncreases = o.mNumInfoIncreases;
+            mNumRehashes = o.mNumRehashes;
             // set other's mask to 0 so its destructor won't do anything
             o.init();
         }
@@ -1818,6 +2038,10 @@ public:
                 mMaxNumElementsAllowed = std::move(o.mMaxNumElementsAllowed);
                 mInfoInc = std::move(o.mInfoInc);
                 mInfoHashShift = std::move(o.mInfoHashShift);
+                mNumInfoIncreases = o.mNumInfoIncreases;
+                mNumRehashes = o.mNumRehashes;
+                mMaxLoadFactor100 = o.mMaxLoadFactor100;
+                mGrowthFactor100 = o.mGrowthFactor100;
                 WHash::operator=(std::move(static_cast<WHash&>(o)));
                 WKeyEqual::operator=(std::move(static_cast<WKeyEqual&>(o)));
                 DataPool::operator=(std::move(static_cast<DataPool&>(o)));
@@ -1837,13 +2061,15 @@ public:
         , WKeyEqual(static_cast<const WKeyEqual&>(o))
         , DataPool(static_cast<const DataPool&>(o)) {
         ROBIN_HOOD_TRACE(this)
+        mMaxLoadFactor100 = o.mMaxLoadFactor100;
+        mGrowthFactor100 = o.mGrowthFactor100;
         if (!o.empty()) {
             // not empty: create an exact copy. it is also possible to just iterate through all
             // elements and insert them, but copying is probably faster.
 
             auto const numElementsWithBuffer = calcNumElementsWithBuffer(o.mMask + 1);
             mKeyVals = static_cast<Node*>(detail::assertNotNull<std::bad_alloc>(
-                std::malloc(calcNumBytesTotal(numElementsWithBuffer))));
+                allocator().allocate(calcNumBytesTotal(numElementsWithBuffer))));
             // no need for calloc because clonData does memcpy
             mInfo = reinterpret_cast<uint8_t*>(mKeyVals + numElementsWithBuffer);
             mNumElements = o.mNumElements;
@@ -1877,6 +2103,8 @@ public:
             // clear also resets mInfo to 0, that's sometimes not necessary.
             destroy();
             init();
+            mMaxLoadFactor100 = o.mMaxLoadFactor100;
+            mGrowthFactor100 = o.mGrowthFactor100;
             WHash::operator=(static_cast<const WHash&>(o));
             WKeyEqual::operator=(static_cast<const WKeyEqual&>(o));
             DataPool::operator=(static_cast<DataPool const&>(o));
@@ -1891,12 +2119,13 @@ public:
             // no luck: we don't have the same array size allocated, so we need to realloc.
             if (0 != mMask) {
                 // only deallocate if we actually have data!
-                std::free(mKeyVals);
+                allocator().deallocate(mKeyVals,
+                                       calcNumBytesTotal(calcNumElementsWithBuffer(mMask + 1)));
             }
 
             auto const numElementsWithBuffer = calcNumElementsWithBuffer(o.mMask + 1);
             mKeyVals = static_cast<Node*>(detail::assertNotNull<std::bad_alloc>(
-                std::malloc(calcNumBytesTotal(numElementsWithBuffer))));
+                allocator().allocate(calcNumBytesTotal(numElementsWithBuffer))));
 
             // no need for calloc here because cloneData performs a memcpy.
             mInfo = reinterpret_cast<uint8_t*>(mKeyVals + numElementsWithBuffer);
@@ -1910,6 +2139,8 @@ public:
         mMaxNumElementsAllowed = o.mMaxNumElementsAllowed;
         mInfoInc = o.mInfoInc;
         mInfoHashShift = o.mInfoHashShift;
+        mMaxLoadFactor100 = o.mMaxLoadFactor100;
+        mGrowthFactor100 = o.mGrowthFactor100;
         cloneData(o);
 
         return *this;
@@ -2156,6 +2387,23 @@ public:
         return iterator{mKeyVals + idx, mInfo + idx};
     }
 
+    // Finds numKeys keys at once, storing in result[i] the same iterator that find(keys[i])
+    // returns. Faster than individual find() calls when the table does not fit in cache,
+    // because the memory accesses of independent lookups are overlapped with prefetching.
+    void find_batch(key_type const* keys, size_t numKeys, const_iterator* result) const {
+        ROBIN_HOOD_TRACE(this)
+        findIdxBatch(keys, numKeys, [this, result](size_t i, size_t idx) {
+            result[i] = const_iterator{mKeyVals + idx, mInfo + idx};
+        });
+    }
+
+    void find_batch(key_type const* keys, size_t numKeys, iterator* result) {
+        ROBIN_HOOD_TRACE(this)
+        findIdxBatch(keys, numKeys, [this, result](size_t i, size_t idx) {
+            result[i] = iterator{mKeyVals + idx, mInfo + idx};
+        });
+    }
+
     iterator begin() {
         ROBIN_HOOD_TRACE(this)
         if (empty()) {
@@ -2248,13 +2496,13 @@ public:
         auto const minElementsAllowed = (std::max)(c, mNumElements);
         auto newSize = InitialNumElements;
         while (calcMaxNumElementsAllowed(newSize) < minElementsAllowed && newSize != 0) {
-            newSize *= 2;
+            newSize = calcNextNumBuckets(newSize);
         }
         if (ROBIN_HOOD_UNLIKELY(newSize == 0)) {
             throwOverflowError();
         }
 
-        rehashPowerOfTwo(newSize);
+        rehashNumBuckets(newSize);
     }
 
     size_type size() const noexcept { // NOLINT(modernize-use-nodiscard)
@@ -2274,7 +2522,39 @@ public:
 
     float max_load_factor() const noexcept { // NOLINT(modernize-use-nodiscard)
         ROBIN_HOOD_TRACE(this)
-        return MaxLoadFactor100 / 100.0F;
+        return static_cast<float>(mMaxLoadFactor100) / 100.0F;
+    }
+
+    // Sets the load factor at which the table grows, starting from MaxLoadFactor100. It is
+    // clamped to the same range, ]0.1, 0.99]. Lowering it below the current load rehashes.
+    void max_load_factor(float ml) {
+        ROBIN_HOOD_TRACE(this)
+        auto const ml100 = static_cast<int>(ml * 100.0F + 0.5F);
+        mMaxLoadFactor100 = static_cast<uint32_t>((std::min)((std::max)(ml100, 11), 99));
+        if (0 == mMask) {
+            return;
+        }
+        if (mNumElements > calcMaxNumElementsAllowed(mMask + 1)) {
+            reserve(mNumElements);
+        } else if (0 != mMaxNumElementsAllowed) {
+            // 0 means the info bytes are about to overflow, keep it so the next insert handles it
+            mMaxNumElementsAllowed = calcMaxNumElementsAllowed(mMask + 1);
+        }
+    }
+
+    // Factor by which the number of buckets grows when the table is full, 2 by default.
+    float growth_factor() const noexcept { // NOLINT(modernize-use-nodiscard)
+        ROBIN_HOOD_TRACE(this)
+        return static_cast<float>(mGrowthFactor100) / 100.0F;
+    }
+
+    // Sets the growth factor, clamped to [1.25, 4]. Smaller factors, e.g. 1.5, lower the peak
+    // memory of a rehash, when the old and the new table are both allocated, from 3x to 2.5x the
+    // old table and waste less memory on average, at the cost of more frequent rehashes.
+    void growth_factor(float gf) {
+        ROBIN_HOOD_TRACE(this)
+        auto const gf100 = static_cast<int>(gf * 100.0F + 0.5F);
+        mGrowthFactor100 = static_cast<uint32_t>((std::min)((std::max)(gf100, 125), 400));
     }
 
     // Average number of elements per bucket. Since we allow only 1 per bucket
@@ -2283,18 +2563,102 @@ public:
         return static_cast<float>(size()) / static_cast<float>(mMask + 1);
     }
 
+    // Number of buckets minus one. It is a bit mask only when the growth factor is 2.
     ROBIN_HOOD(NODISCARD) size_t mask() const noexcept {
         ROBIN_HOOD_TRACE(this)
         return mMask;
     }
 
+    // Walks the info bytes to build the probe distance histogram, so this is O(buckets).
+    ROBIN_HOOD(NODISCARD) TableStats stats() const noexcept {
+        ROBIN_HOOD_TRACE(this)
+        TableStats s;
+        s.numElements = mNumElements;
+        s.maxLoadFactor = max_load_factor();
+        s.growthFactor = growth_factor();
+        s.maxNumElementsAllowed = mMaxNumElementsAllowed;
+        s.numInfoIncreases = mNumInfoIncreases;
+        s.numRehashes = mNumRehashes;
+        if (0 == mMask) {
+            return s;
+        }
+        s.numBuckets = mMask + 1;
+        s.loadFactor = load_factor();
+
+        auto const numElementsWithBuffer = calcNumElementsWithBuffer(mMask + 1);
+        s.numBytes = calcNumBytesTotal(numElementsWithBuffer);
+        if (!IsFlat) {
+            s.numBytes += mNumElements * sizeof(value_type);
+        }
+        for (size_t i = 0; i < numElementsWithBuffer; ++i) {
+            if (mInfo[i] != 0) {
+                ++s.probeHistogram[mInfo[i] / mInfoInc - 1];
+            }
+        }
+        return s;
+    }
+
+    // Size in bytes of the snapshot written by writeSnapshot().
+    ROBIN_HOOD(NODISCARD) size_t snapshotSize() const noexcept {
+        return detail::SnapshotHeader::calcNodesOffset(alignof(Node)) +
+               (0 == mMask ? 0 : calcNumBytesTotal(calcNumElementsWithBuffer(mMask + 1)));
+    }
+
+    // Writes the table to buffer, which needs snapshotSize() bytes, as a relocatable snapshot that
+    // mapped_flat_map probes in place, e.g. from a memory mapped file. The nodes are copied as
+    // bytes, so this is only available for flat maps of trivially copyable keys and values.
+    void writeSnapshot(void* buffer) const {
+        ROBIN_HOOD_TRACE(this)
+        static_assert(IsFlat && is_map && ROBIN_HOOD_IS_TRIVIALLY_COPYABLE(Node) &&
+                          sizeof(Node) == sizeof(value_type),
+                      "snapshots need a flat map of trivially copyable keys and values");
+        detail::SnapshotHeader header;
+        header.sizeOfValue = sizeof(value_type);
+        header.alignOfValue = alignof(value_type);
+        header.infoInc = mInfoInc;
+        header.infoHashShift = mInfoHashShift;
+        header.numElements = mNumElements;
+        header.nodesOffset = detail::SnapshotHeader::calcNodesOffset(alignof(Node));
+        header.infoOffset = header.nodesOffset;
+        header.size = snapshotSize();
+        if (0 != mMask) {
+            auto const numElementsWithBuffer = calcNumElementsWithBuffer(mMask + 1);
+            header.numBuckets = mMask + 1;
+            header.numElementsWithBuffer = numElementsWithBuffer;
+            header.infoOffset += numElementsWithBuffer * sizeof(Node);
+            for (size_t i = 0; i < numElementsWithBuffer; ++i) {
+                if (mInfo[i] != 0) {
+                    header.hashCheck = hashKey(mKeyVals[i].getFirst());
+                    break;
+                }
+            }
+            std::memcpy(static_cast<char*>(buffer) + header.nodesOffset, mKeyVals,
+                        calcNumBytesTotal(numElementsWithBuffer));
+        }
+        std::memcpy(buffer, &header, sizeof(header));
+    }
+
     ROBIN_HOOD(NODISCARD) size_t calcMaxNumElementsAllowed(size_t maxElements) const noexcept {
         if (ROBIN_HOOD_LIKELY(maxElements <= (std::numeric_limits<size_t>::max)() / 100)) {
-            return maxElements * MaxLoadFactor100 / 100;
+            return maxElements * mMaxLoadFactor100 / 100;
         }
 
         // we might be a bit inprecise, but since maxElements is quite large that doesn't matter
-        return (maxElements / 100) * MaxLoadFactor100;
+        return (maxElements / 100) * mMaxLoadFactor100;
+    }
+
+    // Number of buckets after growing from numBuckets, at most MaxNumBuckets, or 0 on overflow.
+    ROBIN_HOOD(NODISCARD) size_t calcNextNumBuckets(size_t numBuckets) const noexcept {
+        auto const current = static_cast<uint64_t>(numBuckets);
+        if (ROBIN_HOOD_UNLIKELY(current >= MaxNumBuckets)) {
+            return 0;
+        }
+        auto next = (std::max)(current * mGrowthFactor100 / 100, current + 1);
+        next = next < MaxNumBuckets ? next : MaxNumBuckets;
+        if (ROBIN_HOOD_UNLIKELY(next > (std::numeric_limits<size_t>::max)())) {
+            return 0;
+        }
+        return static_cast<size_t>(next);
     }
 
     ROBIN_HOOD(NODISCARD) size_t calcNumBytesInfo(size_t numElements) const noexcept {
@@ -2303,9 +2667,15 @@ public:
         return numElements + sizeof(uint64_t);
     }
 
+    // The overflow buffer is sized for the highest max load factor, 99%, and not for
+    // mMaxLoadFactor100, so that changing the load factor keeps the size of an existing
+    // allocation and tables with the same mMask can share their data layout.
     ROBIN_HOOD(NODISCARD)
-    size_t calcNumElementsWithBuffer(size_t numElements) const noexcept {
-        auto maxNumElementsAllowed = calcMaxNumElementsAllowed(numElements);
+    static size_t calcNumElementsWithBuffer(size_t numElements) noexcept {
+        auto maxNumElementsAllowed =
+            ROBIN_HOOD_LIKELY(numElements <= (std::numeric_limits<size_t>::max)() / 100)
+                ? numElements * 99 / 100
+                : (numElements / 100) * 99;
         return numElements + (std::min)(maxNumElementsAllowed, (static_cast<size_t>(0xFF)));
     }
 
@@ -2345,13 +2715,13 @@ private:
         return find(e) != end();
     }
 
-    // reserves space for at least the specified number of elements.
-    // only works if numBuckets if power of two
-    void rehashPowerOfTwo(size_t numBuckets) {
+    // reallocates the table with numBuckets buckets and reinserts all elements.
+    void rehashNumBuckets(size_t numBuckets) {
         ROBIN_HOOD_TRACE(this)
 
         Node* const oldKeyVals = mKeyVals;
         uint8_t const* const oldInfo = mInfo;
+        ++mNumRehashes;
 
         const size_t oldMaxElementsWithBuffer = calcNumElementsWithBuffer(mMask + 1);
 
@@ -2402,6 +2772,10 @@ private:
         return {it, false};
     }
 
+    Allocator& allocator() noexcept {
+        return static_cast<Allocator&>(*this);
+    }
+
     void init_data(size_t max_elements) {
         mNumElements = 0;
         mMask = max_elements - 1;
@@ -2409,9 +2783,9 @@ private:
 
         auto const numElementsWithBuffer = calcNumElementsWithBuffer(max_elements);
 
-        // calloc also zeroes everything
+        // everything starts zeroed, i.e. empty
         mKeyVals = reinterpret_cast<Node*>(detail::assertNotNull<std::bad_alloc>(
-            std::calloc(1, calcNumBytesTotal(numElementsWithBuffer))));
+            detail::allocateZeroed(allocator(), calcNumBytesTotal(numElementsWithBuffer))));
         mInfo = reinterpret_cast<uint8_t*>(mKeyVals + numElementsWithBuffer);
 
         // set sentinel
@@ -2542,6 +2916,7 @@ private:
         }
         // we got space left, try to make info smaller
         mInfoInc = static_cast<uint8_t>(mInfoInc >> 1U);
+        ++mNumInfoIncreases;
 
         // remove one bit of the hash, leaving more space for the distance info.
         // This is extremely fast because we can operate on 8 bytes at once.
@@ -2581,7 +2956,11 @@ private:
             throwOverflowError();
         }
 
-        rehashPowerOfTwo((mMask + 1) * 2);
+        auto const numBuckets = calcNextNumBuckets(mMask + 1);
+        if (ROBIN_HOOD_UNLIKELY(numBuckets == 0)) {
+            throwOverflowError();
+        }
+        rehashNumBuckets(numBuckets);
     }
 
     void destroy() {
@@ -2598,7 +2977,8 @@ private:
         // reports a compile error: attempt to free a non-heap object ‘fm’
         // [-Werror=free-nonheap-object]
         if (mKeyVals != reinterpret_cast_no_cast_align_warning<Node*>(&mMask)) {
-            std::free(mKeyVals);
+            allocator().deallocate(mKeyVals,
+                                   calcNumBytesTotal(calcNumElementsWithBuffer(mMask + 1)));
         }
     }
 
@@ -2610,6 +2990,8 @@ private:
         mMaxNumElementsAllowed = 0;
         mInfoInc = InitialInfoInc;
         mInfoHashShift = InitialInfoHashShift;
+        mNumInfoIncreases = 0;
+        mNumRehashes = 0;
     }
 
     // members are sorted so no padding occurs
@@ -2620,45 +3002,1119 @@ private:
     size_t mMaxNumElementsAllowed = 0;                                      // 8 byte 40
     InfoType mInfoInc = InitialInfoInc;                                     // 4 byte 44
     InfoType mInfoHashShift = InitialInfoHashShift;                         // 4 byte 48
-                                                    // 16 byte 56 if NodeAllocator
+    uint32_t mNumInfoIncreases = 0;                                         // 4 byte 52
+    uint32_t mNumRehashes = 0;                                              // 4 byte 56
+    uint32_t mMaxLoadFactor100 = MaxLoadFactor100;                          // 4 byte 60
+    uint32_t mGrowthFactor100 = 200;                                        // 4 byte 64
+                                                    // 16 byte 80 if NodeAllocator
 };
 
-} // namespace detail
+// Control bytes and groups of SwissTable.
+namespace swiss {
 
-// map
+// Control byte values. Full slots store the low 7 bits of the hash, so they are never negative.
+constexpr int8_t Empty = -128;
+constexpr int8_t Deleted = -2;
+constexpr int8_t Sentinel = -1;
+
+// Number of control bytes that are matched at once.
+constexpr size_t GroupWidth = 16;
+
+// Group of GroupWidth control bytes. Bit i of each returned mask is set if byte i matches.
+#if ROBIN_HOOD(HAS_SSE2)
+class Group {
+public:
+    explicit Group(int8_t const* ctrl) noexcept
+        : mCtrl(_mm_loadu_si128(reinterpret_cast<__m128i const*>(ctrl))) {}
+
+    uint32_t match(int8_t h2) const noexcept {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), mCtrl)));
+    }
+    uint32_t matchEmpty() const noexcept {
+        return match(Empty);
+    }
+    // Empty and Deleted are the only values smaller than Sentinel.
+    uint32_t matchEmptyOrDeleted() const noexcept {
+        return static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(Sentinel), mCtrl)));
+    }
+
+private:
+    __m128i mCtrl;
+};
+#else
+class Group {
+public:
+    explicit Group(int8_t const* ctrl) noexcept
+        : mCtrl(ctrl) {}
+
+    uint32_t match(int8_t h2) const noexcept {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(mCtrl[i] == h2) << i;
+        }
+        return mask;
+    }
+    uint32_t matchEmpty() const noexcept {
+        return match(Empty);
+    }
+    uint32_t matchEmptyOrDeleted() const noexcept {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(mCtrl[i] < Sentinel) << i;
+        }
+        return mask;
+    }
+
+private:
+    int8_t const* mCtrl;
+};
+#endif
+
+// Index of the lowest set bit of a non-zero mask.
+inline size_t lowestBit(uint32_t mask) noexcept {
+#if defined(ROBIN_HOOD_COUNT_TRAILING_ZEROES)
+    return static_cast<size_t>(ROBIN_HOOD_COUNT_TRAILING_ZEROES(mask));
+#else
+    size_t idx = 0;
+    while (0U == (mask & 1U)) {
+        mask >>= 1U;
+        ++idx;
+    }
+    return idx;
+#endif
+}
+
+// Control bytes shared by all tables without slots, so that lookups need no special case. The
+// leading sentinel makes begin() == end(). Never written to.
+inline int8_t* emptyGroup() noexcept {
+    static int8_t group[GroupWidth] = {Sentinel, Empty, Empty, Empty, Empty, Empty, Empty, Empty,
+                                       Empty,    Empty, Empty, Empty, Empty, Empty, Empty, Empty};
+    return group;
+}
+
+} // namespace swiss
+
+// An open addressing hashmap with SwissTable style group probing, as an alternative to the Robin
+// Hood Table for lookup and miss heavy workloads with long probe sequences.
+//
+// This implementation uses the following memory layout:
+//
+// [ctrl, ctrl, ... ctrl, ctrlSentinel, padding | slot, slot, ... slot ]
+//
+// * ctrl: Each slot has a control byte that is either Empty, Deleted, or the low 7 bits of the
+//   hash (H2) of the key in the slot. There are always 2^n slots, at least GroupWidth.
+//
+// * Probing: slots are probed in aligned groups of GroupWidth, starting from the group given by
+//   the remaining bits of the hash (H1). All control bytes of a group are compared to H2 at once,
+//   with SSE2 if available, so keys are only compared for matching fingerprints. Probing stops
+//   at the first group with an Empty byte. Groups are visited in triangular order, which covers
+//   all groups of the table.
+//
+// * Erasing leaves a Deleted tombstone, or an Empty byte if the group already has one, since then
+//   no probe sequence ever went past the group. Tombstones count towards the load and are
+//   dropped when the table is rehashed.
+//
+// * ctrlSentinel: Sentinel byte, so that iterator's ++ can stop at end().
+//
+// Only maps are supported. Values are stored in the slots like unordered_flat_map, whose interface
+// this class follows, and move when the table grows. Allocator provides the memory of the control
+// bytes and slots, like for Table.
+template <size_t MaxLoadFactor100, typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator = MallocAllocator>
+class SwissTable
+    : public WrapHash<Hash>,
+      public WrapKeyEqual<KeyEqual>,
+      detail::NodeAllocator<robin_hood::pair<Key, T>, 4, 16384, true, Allocator> {
+public:
+    static constexpr bool is_flat = true;
+    static constexpr bool is_map = true;
+    static constexpr bool is_set = false;
+    static constexpr bool is_transparent =
+        has_is_transparent<Hash>::value && has_is_transparent<KeyEqual>::value;
+
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = robin_hood::pair<Key, T>;
+    using size_type = size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+    using Self =
+        SwissTable<MaxLoadFactor100, key_type, mapped_type, hasher, key_equal, allocator_type>;
+
+private:
+    static_assert(MaxLoadFactor100 > 10 && MaxLoadFactor100 < 100,
+                  "MaxLoadFactor100 needs to be >10 && < 100");
+    static_assert(!std::is_void<T>::value, "SwissTable only supports maps");
+    static_assert(alignof(value_type) <= swiss::GroupWidth,
+                  "slots are placed after the control bytes, aligned to GroupWidth");
+
+    using WHash = WrapHash<Hash>;
+    using WKeyEqual = WrapKeyEqual<KeyEqual>;
+    using DataPool = detail::NodeAllocator<value_type, 4, 16384, true, Allocator>;
+
+    // Whether the arguments of emplace are a value_type, or a key_type and the mapped value, so
+    // that the key can be looked up before anything is constructed.
+    template <typename... Args>
+    struct HoldsKey : std::false_type {};
+
+    template <typename Arg>
+    struct HoldsKey<Arg> : std::is_same<typename std::decay<Arg>::type, value_type> {};
+
+    template <typename OtherKey, typename Mapped>
+    struct HoldsKey<OtherKey, Mapped>
+        : std::is_same<typename std::decay<OtherKey>::type, key_type> {};
+
+    // Iter ////////////////////////////////////////////////////////////
+
+    // generic iterator for both const_iterator and iterator.
+    template <bool IsConst>
+    // NOLINTNEXTLINE(hicpp-special-member-functions,cppcoreguidelines-special-member-functions)
+    class Iter {
+    private:
+        using SlotPtr = typename std::conditional<IsConst, typename Self::value_type const*,
+                                                  typename Self::value_type*>::type;
+
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = typename Self::value_type;
+        using reference = typename std::conditional<IsConst, value_type const&, value_type&>::type;
+        using pointer = typename std::conditional<IsConst, value_type const*, value_type*>::type;
+        using iterator_category = std::forward_iterator_tag;
+
+        Iter() = default;
+
+        // Conversion constructor from iterator to const_iterator.
+        template <bool OtherIsConst,
+                  typename = typename std::enable_if<IsConst && !OtherIsConst>::type>
+        // NOLINTNEXTLINE(hicpp-explicit-conversions)
+        Iter(Iter<OtherIsConst> const& other) noexcept
+            : mCtrl(other.mCtrl)
+            , mSlot(other.mSlot) {}
+
+        Iter(int8_t const* ctrlPtr, SlotPtr slotPtr) noexcept
+            : mCtrl(ctrlPtr)
+            , mSlot(slotPtr) {}
+
+        // prefix increment. Undefined behavior if we are at end()!
+        Iter& operator++() noexcept {
+            ++mCtrl;
+            ++mSlot;
+            fastForward();
+            return *this;
+        }
+
+        Iter operator++(int) noexcept {
+            Iter tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        reference operator*() const {
+            return *mSlot;
+        }
+
+        pointer operator->() const {
+            return mSlot;
+        }
+
+        template <bool O>
+        bool operator==(Iter<O> const& o) const noexcept {
+            return mSlot == o.mSlot;
+        }
+
+        template <bool O>
+        bool operator!=(Iter<O> const& o) const noexcept {
+            return mSlot != o.mSlot;
+        }
+
+    private:
+        // skips Empty and Deleted slots, stops at the next full slot or the sentinel
+        void fastForward() noexcept {
+            while (*mCtrl < swiss::Sentinel) {
+                ++mCtrl;
+                ++mSlot;
+            }
+        }
+
+        template <bool>
+        friend class Iter;
+        friend class SwissTable<MaxLoadFactor100, key_type, mapped_type, hasher, key_equal,
+                                allocator_type>;
+        int8_t const* mCtrl{nullptr};
+        SlotPtr mSlot{nullptr};
+    };
+
+public:
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    // Creates an empty hash map. Nothing is allocated until the first insert, lookups of the
+    // empty map probe the shared swiss::emptyGroup().
+    explicit SwissTable(
+        size_t ROBIN_HOOD_UNUSED(bucket_count) /*unused*/ = 0, const Hash& h = Hash{},
+        const KeyEqual& equal = KeyEqual{},
+        const Allocator& alloc = Allocator{}) noexcept(noexcept(Hash(h)) &&
+                                                       noexcept(KeyEqual(equal)))
+        : WHash(h)
+        , WKeyEqual(equal)
+        , DataPool(alloc) {}
+
+    explicit SwissTable(const Allocator& alloc) noexcept(noexcept(Hash()) && noexcept(KeyEqual()))
+        : DataPool(alloc) {}
+
+    template <typename Iter>
+    SwissTable(Iter first, Iter last, size_t ROBIN_HOOD_UNUSED(bucket_count) /*unused*/ = 0,
+               const Hash& h = Hash{}, const KeyEqual& equal = KeyEqual{},
+               const Allocator& alloc = Allocator{})
+        : WHash(h)
+        , WKeyEqual(equal)
+        , DataPool(alloc) {
+        insert(first, last);
+    }
+
+    SwissTable(std::initializer_list<value_type> initlist,
+               size_t ROBIN_HOOD_UNUSED(bucket_count) /*unused*/ = 0, const Hash& h = Hash{},
+               const KeyEqual& equal = KeyEqual{}, const Allocator& alloc = Allocator{})
+        : WHash(h)
+        , WKeyEqual(equal)
+        , DataPool(alloc) {
+        insert(initlist.begin(), initlist.end());
+    }
+
+    allocator_type get_allocator() const noexcept {
+        return static_cast<const Allocator&>(*this);
+    }
+
+    SwissTable(SwissTable&& o) noexcept
+        : WHash(std::move(static_cast<WHash&>(o)))
+        , WKeyEqual(std::move(static_cast<WKeyEqual&>(o)))
+        , DataPool(std::move(static_cast<DataPool&>(o))) {
+        steal(o);
+    }
+
+    // Takes the Allocator of o with its data, like Table.
+    SwissTable& operator=(SwissTable&& o) noexcept {
+        if (&o != this) {
+            destroy();
+            WHash::operator=(std::move(static_cast<WHash&>(o)));
+            WKeyEqual::operator=(std::move(static_cast<WKeyEqual&>(o)));
+            DataPool::operator=(std::move(static_cast<DataPool&>(o)));
+            steal(o);
+        }
+        return *this;
+    }
+
+    SwissTable(const SwissTable& o)
+        : WHash(static_cast<const WHash&>(o))
+        , WKeyEqual(static_cast<const WKeyEqual&>(o))
+        , DataPool(static_cast<const DataPool&>(o)) {
+        cloneData(o);
+    }
+
+    // Copies the elements into memory of this Allocator, which is kept like in Table.
+    SwissTable& operator=(SwissTable const& o) {
+        if (&o != this) {
+            destroy();
+            WHash::operator=(static_cast<const WHash&>(o));
+            WKeyEqual::operator=(static_cast<const WKeyEqual&>(o));
+            DataPool::operator=(static_cast<const DataPool&>(o));
+            cloneData(o);
+        }
+        return *this;
+    }
+
+    ~SwissTable() {
+        destroy();
+    }
+
+    void swap(SwissTable& o) {
+        using std::swap;
+        swap(static_cast<WHash&>(*this), static_cast<WHash&>(o));
+        swap(static_cast<WKeyEqual&>(*this), static_cast<WKeyEqual&>(o));
+        swap(static_cast<DataPool&>(*this), static_cast<DataPool&>(o));
+        swap(mCtrl, o.mCtrl);
+        swap(mSlots, o.mSlots);
+        swap(mCapacity, o.mCapacity);
+        swap(mGroupMask, o.mGroupMask);
+        swap(mNumElements, o.mNumElements);
+        swap(mGrowthLeft, o.mGrowthLeft);
+    }
+
+    // Destroys all elements and drops tombstones, but keeps the allocated memory.
+    void clear() {
+        if (mCapacity == 0) {
+            return;
+        }
+        destroyElements();
+        std::memset(mCtrl, swiss::Empty, mCapacity);
+        mNumElements = 0;
+        mGrowthLeft = calcMaxNumElementsAllowed(mCapacity);
+    }
+
+    bool operator==(const SwissTable& other) const {
+        if (other.size() != size()) {
+            return false;
+        }
+        for (auto const& kv : other) {
+            auto it = find(kv.first);
+            if (it == end() || !(it->second == kv.second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const SwissTable& other) const {
+        return !operator==(other);
+    }
+
+    T& operator[](const key_type& key) {
+        return try_emplace_impl(key).first->second;
+    }
+
+    T& operator[](key_type&& key) {
+        return try_emplace_impl(std::move(key)).first->second;
+    }
+
+    template <typename Iter>
+    void insert(Iter first, Iter last) {
+        for (; first != last; ++first) {
+            emplace(*first);
+        }
+    }
+
+    // A value_type, or a key_type and the mapped value, are only copied into the table if the
+    // key is not found. Other arguments are first constructed into a value_type for its key.
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return emplace_impl(HoldsKey<Args...>{}, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+        return try_emplace_impl(key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args) {
+        return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const_iterator hint, const key_type& key,
+                                          Args&&... args) {
+        (void)hint;
+        return try_emplace_impl(key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const_iterator hint, key_type&& key, Args&&... args) {
+        (void)hint;
+        return try_emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <typename Mapped>
+    std::pair<iterator, bool> insert_or_assign(const key_type& key, Mapped&& obj) {
+        return insert_or_assign_impl(key, std::forward<Mapped>(obj));
+    }
+
+    template <typename Mapped>
+    std::pair<iterator, bool> insert_or_assign(key_type&& key, Mapped&& obj) {
+        return insert_or_assign_impl(std::move(key), std::forward<Mapped>(obj));
+    }
+
+    template <typename Mapped>
+    std::pair<iterator, bool> insert_or_assign(const_iterator hint, const key_type& key,
+                                               Mapped&& obj) {
+        (void)hint;
+        return insert_or_assign_impl(key, std::forward<Mapped>(obj));
+    }
+
+    template <typename Mapped>
+    std::pair<iterator, bool> insert_or_assign(const_iterator hint, key_type&& key, Mapped&& obj) {
+        (void)hint;
+        return insert_or_assign_impl(std::move(key), std::forward<Mapped>(obj));
+    }
+
+    std::pair<iterator, bool> insert(const value_type& keyval) {
+        return insert_impl(keyval);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& keyval) {
+        return insert_impl(std::move(keyval));
+    }
+
+    // Returns 1 if key is found, 0 otherwise.
+    size_t count(const key_type& key) const { // NOLINT(modernize-use-nodiscard)
+        return findIdx(key, hashKey(key)) != mCapacity ? 1 : 0;
+    }
+
+    template <typename OtherKey, typename Self_ = Self>
+    // NOLINTNEXTLINE(modernize-use-nodiscard)
+    typename std::enable_if<Self_::is_transparent, size_t>::type count(const OtherKey& key) const {
+        return findIdx(key, hashKey(key)) != mCapacity ? 1 : 0;
+    }
+
+    bool contains(const key_type& key) const { // NOLINT(modernize-use-nodiscard)
+        return 1U == count(key);
+    }
+
+    template <typename OtherKey, typename Self_ = Self>
+    // NOLINTNEXTLINE(modernize-use-nodiscard)
+    typename std::enable_if<Self_::is_transparent, bool>::type contains(const OtherKey& key) const {
+        return 1U == count(key);
+    }
+
+    // Returns a reference to the value found for key.
+    // Throws std::out_of_range if element cannot be found
+    T& at(key_type const& key) {
+        auto const idx = findIdx(key, hashKey(key));
+        if (idx == mCapacity) {
+            doThrow<std::out_of_range>("key not found");
+        }
+        return mSlots[idx].second;
+    }
+
+    // Returns a reference to the value found for key.
+    // Throws std::out_of_range if element cannot be found
+    T const& at(key_type const& key) const { // NOLINT(modernize-use-nodiscard)
+        auto const idx = findIdx(key, hashKey(key));
+        if (idx == mCapacity) {
+            doThrow<std::out_of_range>("key not found");
+        }
+        return mSlots[idx].second;
+    }
+
+    const_iterator find(const key_type& key) const { // NOLINT(modernize-use-nodiscard)
+        return iteratorAt(findIdx(key, hashKey(key)));
+    }
+
+    template <typename OtherKey, typename Self_ = Self>
+    typename std::enable_if<Self_::is_transparent, // NOLINT(modernize-use-nodiscard)
+                            const_iterator>::type  // NOLINT(modernize-use-nodiscard)
+    find(const OtherKey& key) const {              // NOLINT(modernize-use-nodiscard)
+        return iteratorAt(findIdx(key, hashKey(key)));
+    }
+
+    iterator find(const key_type& key) {
+        return iteratorAt(findIdx(key, hashKey(key)));
+    }
+
+    template <typename OtherKey, typename Self_ = Self>
+    typename std::enable_if<Self_::is_transparent, iterator>::type find(const OtherKey& key) {
+        return iteratorAt(findIdx(key, hashKey(key)));
+    }
+
+    iterator begin() {
+        iterator it(mCtrl, mSlots);
+        it.fastForward();
+        return it;
+    }
+    const_iterator begin() const { // NOLINT(modernize-use-nodiscard)
+        return cbegin();
+    }
+    const_iterator cbegin() const { // NOLINT(modernize-use-nodiscard)
+        const_iterator it(mCtrl, mSlots);
+        it.fastForward();
+        return it;
+    }
+
+    iterator end() {
+        return iteratorAt(mCapacity);
+    }
+    const_iterator end() const { // NOLINT(modernize-use-nodiscard)
+        return cend();
+    }
+    const_iterator cend() const { // NOLINT(modernize-use-nodiscard)
+        return iteratorAt(mCapacity);
+    }
+
+    // Erases the element at pos. Other elements do not move, so the returned iterator is the
+    // element that followed pos.
+    iterator erase(const_iterator pos) {
+        auto const idx = static_cast<size_t>(pos.mSlot - mSlots);
+        eraseIdx(idx);
+        auto it = iteratorAt(idx);
+        it.fastForward();
+        return it;
+    }
+
+    iterator erase(iterator pos) {
+        return erase(const_iterator(pos));
+    }
+
+    size_t erase(const key_type& key) {
+        auto const idx = findIdx(key, hashKey(key));
+        if (idx == mCapacity) {
+            return 0;
+        }
+        eraseIdx(idx);
+        return 1;
+    }
+
+    // Rehashes into the smallest table that fits max(c, size()) elements, dropping tombstones.
+    void rehash(size_t c) {
+        auto const minElements = (std::max)(c, mNumElements);
+        if (minElements == 0 && mCapacity == 0) {
+            return;
+        }
+        rehashPowerOfTwo(calcCapacity(minElements));
+    }
+
+    // Makes room for c elements without rehashing. Never shrinks.
+    void reserve(size_t c) {
+        auto const minElements = (std::max)(c, mNumElements);
+        if (minElements == 0) {
+            return;
+        }
+        auto const capacity = calcCapacity(minElements);
+        if (capacity > mCapacity) {
+            rehashPowerOfTwo(capacity);
+        }
+    }
+
+    size_type size() const noexcept { // NOLINT(modernize-use-nodiscard)
+        return mNumElements;
+    }
+
+    size_type max_size() const noexcept { // NOLINT(modernize-use-nodiscard)
+        return static_cast<size_type>(-1);
+    }
+
+    ROBIN_HOOD(NODISCARD) bool empty() const noexcept {
+        return 0 == mNumElements;
+    }
+
+    float max_load_factor() const noexcept { // NOLINT(modernize-use-nodiscard)
+        return MaxLoadFactor100 / 100.0F;
+    }
+
+    // Average number of elements per slot. Since we allow only 1 per slot
+    float load_factor() const noexcept { // NOLINT(modernize-use-nodiscard)
+        return mCapacity == 0 ? 0.0F
+                              : static_cast<float>(size()) / static_cast<float>(mCapacity);
+    }
+
+    ROBIN_HOOD(NODISCARD) size_t mask() const noexcept {
+        return mCapacity == 0 ? 0 : mCapacity - 1;
+    }
+
+    // Number of full and Deleted slots allowed for a table with capacity slots.
+    ROBIN_HOOD(NODISCARD) size_t calcMaxNumElementsAllowed(size_t capacity) const noexcept {
+        if (ROBIN_HOOD_LIKELY(capacity <= (std::numeric_limits<size_t>::max)() / 100)) {
+            return capacity * MaxLoadFactor100 / 100;
+        }
+        // we might be a bit inprecise, but since maxElements is quite large that doesn't matter
+        return (capacity / 100) * MaxLoadFactor100;
+    }
+
+    // Bytes of control bytes, sentinel with padding, and slots.
+    ROBIN_HOOD(NODISCARD) size_t calcNumBytesTotal(size_t capacity) const {
+        auto const ctrlBytes = capacity + swiss::GroupWidth;
+        auto const slotBytes = static_cast<uint64_t>(capacity) * sizeof(value_type);
+        auto const total = static_cast<uint64_t>(ctrlBytes) + slotBytes;
+        if (ROBIN_HOOD_UNLIKELY(slotBytes / sizeof(value_type) != capacity ||
+                                total > static_cast<uint64_t>((std::numeric_limits<size_t>::max)()))) {
+            throwOverflowError();
+        }
+        return static_cast<size_t>(total);
+    }
+
+private:
+    template <typename HashKey>
+    size_t hashKey(HashKey const& key) const {
+        // mix hashes that are not robin_hood::hash, like Table does, since both the low and the
+        // high bits are used
+        using Mix =
+            typename std::conditional<std::is_same<::robin_hood::hash<key_type>, hasher>::value,
+                                      ::robin_hood::detail::identity_hash<size_t>,
+                                      ::robin_hood::hash<size_t>>::type;
+        return Mix{}(WHash::operator()(key));
+    }
+
+    static int8_t h2(size_t h) noexcept {
+        return static_cast<int8_t>(h & 0x7FU);
+    }
+
+    size_t h1(size_t h) const noexcept {
+        return (h >> 7U) & mGroupMask;
+    }
+
+    iterator iteratorAt(size_t idx) noexcept {
+        return iterator(mCtrl + idx, mSlots + idx);
+    }
+
+    const_iterator iteratorAt(size_t idx) const noexcept {
+        return const_iterator(mCtrl + idx, mSlots + idx);
+    }
+
+    // Index of the slot that holds key, or mCapacity if not found.
+    template <typename Other>
+    size_t findIdx(Other const& key, size_t h) const {
+        auto const fingerprint = h2(h);
+        auto group = h1(h);
+        for (size_t step = 1;; ++step) {
+            auto const base = group * swiss::GroupWidth;
+            swiss::Group const g(mCtrl + base);
+            auto mask = g.match(fingerprint);
+            while (0U != mask) {
+                auto const idx = base + swiss::lowestBit(mask);
+                if (ROBIN_HOOD_LIKELY(WKeyEqual::operator()(key, mSlots[idx].first))) {
+                    return idx;
+                }
+                mask &= mask - 1U;
+            }
+            if (ROBIN_HOOD_LIKELY(0U != g.matchEmpty())) {
+                return mCapacity;
+            }
+            group = (group + step) & mGroupMask;
+        }
+    }
+
+    // First Empty or Deleted slot in the probe sequence of h. The table must have one.
+    size_t findFirstNonFull(size_t h) const noexcept {
+        auto group = h1(h);
+        for (size_t step = 1;; ++step) {
+            auto const base = group * swiss::GroupWidth;
+            auto const mask = swiss::Group(mCtrl + base).matchEmptyOrDeleted();
+            if (ROBIN_HOOD_LIKELY(0U != mask)) {
+                return base + swiss::lowestBit(mask);
+            }
+            group = (group + step) & mGroupMask;
+        }
+    }
+
+    // Slot for a new element with hash h, growing the table if needed.
+    size_t findInsertIdx(size_t h) {
+        if (ROBIN_HOOD_UNLIKELY(0 == mGrowthLeft)) {
+            grow();
+        }
+        return findFirstNonFull(h);
+    }
+
+    // Marks the slot at idx, where an element was just constructed, as full.
+    iterator finishInsert(size_t idx, size_t h) noexcept {
+        if (mCtrl[idx] == swiss::Empty) {
+            --mGrowthLeft;
+        }
+        mCtrl[idx] = h2(h);
+        ++mNumElements;
+        return iteratorAt(idx);
+    }
+
+    void eraseIdx(size_t idx) {
+        mSlots[idx].~value_type();
+        auto const base = idx & ~(swiss::GroupWidth - 1);
+        if (0U != swiss::Group(mCtrl + base).matchEmpty()) {
+            mCtrl[idx] = swiss::Empty;
+            ++mGrowthLeft;
+        } else {
+            mCtrl[idx] = swiss::Deleted;
+        }
+        --mNumElements;
+    }
+
+    // Doubles the table, or rehashes at the same size if at least half of the allowed slots are
+    // tombstones.
+    void grow() {
+        if (mCapacity == 0) {
+            rehashPowerOfTwo(swiss::GroupWidth);
+        } else if (mNumElements <= calcMaxNumElementsAllowed(mCapacity) / 2) {
+            rehashPowerOfTwo(mCapacity);
+        } else {
+            if (ROBIN_HOOD_UNLIKELY(mCapacity > (std::numeric_limits<size_t>::max)() / 2)) {
+                throwOverflowError();
+            }
+            rehashPowerOfTwo(mCapacity * 2);
+        }
+    }
+
+    // Smallest capacity that allows minElements elements.
+    size_t calcCapacity(size_t minElements) const {
+        size_t capacity = swiss::GroupWidth;
+        while (calcMaxNumElementsAllowed(capacity) < minElements) {
+            if (ROBIN_HOOD_UNLIKELY(capacity > (std::numeric_limits<size_t>::max)() / 2)) {
+                throwOverflowError();
+            }
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void rehashPowerOfTwo(size_t capacity) {
+        auto* const oldCtrl = mCtrl;
+        auto* const oldSlots = mSlots;
+        auto const oldCapacity = mCapacity;
+        auto const numElements = mNumElements;
+
+        init_data(capacity);
+        for (size_t idx = 0; idx < oldCapacity; ++idx) {
+            if (oldCtrl[idx] >= 0) {
+                auto& kv = oldSlots[idx];
+                auto const h = hashKey(kv.first);
+                auto const newIdx = findFirstNonFull(h);
+                ::new (static_cast<void*>(mSlots + newIdx)) value_type(std::move(kv));
+                kv.~value_type();
+                mCtrl[newIdx] = h2(h);
+            }
+        }
+        mNumElements = numElements;
+        mGrowthLeft -= numElements;
+        if (oldCapacity != 0) {
+            allocator().deallocate(oldCtrl, calcNumBytesTotal(oldCapacity));
+        }
+    }
+
+    Allocator& allocator() noexcept {
+        return static_cast<Allocator&>(*this);
+    }
+
+    void init_data(size_t capacity) {
+        auto const ctrlBytes = capacity + swiss::GroupWidth;
+        auto* const data = static_cast<int8_t*>(detail::assertNotNull<std::bad_alloc>(
+            allocator().allocate(calcNumBytesTotal(capacity))));
+        mCtrl = data;
+        mSlots = reinterpret_cast_no_cast_align_warning<value_type*>(data + ctrlBytes);
+        std::memset(mCtrl, swiss::Empty, ctrlBytes);
+        mCtrl[capacity] = swiss::Sentinel;
+        mCapacity = capacity;
+        mGroupMask = capacity / swiss::GroupWidth - 1;
+        mNumElements = 0;
+        mGrowthLeft = calcMaxNumElementsAllowed(capacity);
+    }
+
+    // Exact copy of o into this empty table, slots stay at the same positions.
+    void cloneData(const SwissTable& o) {
+        if (o.mCapacity == 0) {
+            return;
+        }
+        init_data(o.mCapacity);
+        for (size_t idx = 0; idx < mCapacity; ++idx) {
+            if (o.mCtrl[idx] >= 0) {
+                ::new (static_cast<void*>(mSlots + idx)) value_type(o.mSlots[idx]);
+            }
+        }
+        std::memcpy(mCtrl, o.mCtrl, mCapacity);
+        mNumElements = o.mNumElements;
+        mGrowthLeft = o.mGrowthLeft;
+    }
+
+    template <typename Arg>
+    std::pair<iterator, bool> insert_impl(Arg&& keyval) {
+        auto const h = hashKey(keyval.first);
+        auto idx = findIdx(keyval.first, h);
+        if (idx != mCapacity) {
+            return {iteratorAt(idx), false};
+        }
+        idx = findInsertIdx(h);
+        ::new (static_cast<void*>(mSlots + idx)) value_type(std::forward<Arg>(keyval));
+        return {finishInsert(idx, h), true};
+    }
+
+    template <typename Arg>
+    std::pair<iterator, bool> emplace_impl(std::true_type /*holds key*/, Arg&& keyval) {
+        return insert_impl(std::forward<Arg>(keyval));
+    }
+
+    template <typename OtherKey, typename Mapped>
+    std::pair<iterator, bool> emplace_impl(std::true_type /*holds key*/, OtherKey&& key,
+                                           Mapped&& obj) {
+        return try_emplace_impl(std::forward<OtherKey>(key), std::forward<Mapped>(obj));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace_impl(std::false_type /*holds key*/, Args&&... args) {
+        value_type keyval(std::forward<Args>(args)...);
+        return insert_impl(std::move(keyval));
+    }
+
+    template <typename OtherKey, typename... Args>
+    std::pair<iterator, bool> try_emplace_impl(OtherKey&& key, Args&&... args) {
+        auto const h = hashKey(key);
+        auto idx = findIdx(key, h);
+        if (idx != mCapacity) {
+            return {iteratorAt(idx), false};
+        }
+        idx = findInsertIdx(h);
+        ::new (static_cast<void*>(mSlots + idx))
+            value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<OtherKey>(key)),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+        return {finishInsert(idx, h), true};
+    }
+
+    template <typename OtherKey, typename Mapped>
+    std::pair<iterator, bool> insert_or_assign_impl(OtherKey&& key, Mapped&& obj) {
+        auto it = find(key);
+        if (it == end()) {
+            return try_emplace_impl(std::forward<OtherKey>(key), std::forward<Mapped>(obj));
+        }
+        it->second = std::forward<Mapped>(obj);
+        return {it, false};
+    }
+
+    void destroyElements() noexcept {
+        if (!std::is_trivially_destructible<value_type>::value) {
+            for (size_t idx = 0; idx < mCapacity; ++idx) {
+                if (mCtrl[idx] >= 0) {
+                    mSlots[idx].~value_type();
+                }
+            }
+        }
+    }
+
+    void destroy() {
+        if (mCapacity == 0) {
+            return;
+        }
+        destroyElements();
+        allocator().deallocate(mCtrl, calcNumBytesTotal(mCapacity));
+        init();
+    }
+
+    void init() noexcept {
+        mCtrl = swiss::emptyGroup();
+        mSlots = nullptr;
+        mCapacity = 0;
+        mGroupMask = 0;
+        mNumElements = 0;
+        mGrowthLeft = 0;
+    }
+
+    void steal(SwissTable& o) noexcept {
+        mCtrl = o.mCtrl;
+        mSlots = o.mSlots;
+        mCapacity = o.mCapacity;
+        mGroupMask = o.mGroupMask;
+        mNumElements = o.mNumElements;
+        mGrowthLeft = o.mGrowthLeft;
+        o.init();
+    }
+
+    ROBIN_HOOD(NOINLINE) void throwOverflowError() const {
+#if ROBIN_HOOD(HAS_EXCEPTIONS)
+        throw std::overflow_error("robin_hood::map overflow");
+#else
+        abort();
+#endif
+    }
+
+    int8_t* mCtrl = swiss::emptyGroup(); // 8 byte  8
+    value_type* mSlots = nullptr;        // 8 byte 16
+    size_t mCapacity = 0;                // 8 byte 24
+    size_t mGroupMask = 0;               // 8 byte 32
+    size_t mNumElements = 0;             // 8 byte 40
+    size_t mGrowthLeft = 0;              // 8 byte 48, Empty slots that may still be filled
+};
+
+// Read-only map over a snapshot written by Table::writeSnapshot(). Lookups probe the snapshot in
+// place, without deserialization, so the data must outlive the map and be aligned for
+// value_type, as a memory mapped file is. The construction checks that key, value and size_t
+// sizes match the writer, that the nodes and info arrays with their sentinel lie within the data,
+// and that the hash of a stored key is unchanged.
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+class MappedTable : public WrapHash<Hash>, public WrapKeyEqual<KeyEqual> {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = robin_hood::pair<Key, T>;
+    using size_type = size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+
+private:
+    using WHash = WrapHash<Hash>;
+    using WKeyEqual = WrapKeyEqual<KeyEqual>;
+    using InfoType = uint32_t;
+    static constexpr uint32_t InfoNumBits = 5; // as Table::InitialInfoNumBits
+    static constexpr size_t InfoMask = (1U << InfoNumBits) - 1U;
+
+public:
+    MappedTable(void const* data, size_t size, const Hash& h = Hash{},
+                const KeyEqual& equal = KeyEqual{})
+        : WHash(h)
+        , WKeyEqual(equal) {
+        static_assert(ROBIN_HOOD_IS_TRIVIALLY_COPYABLE(value_type),
+                      "snapshots need trivially copyable keys and values");
+        SnapshotHeader header;
+        if (size < sizeof(header)) {
+            throwInvalidSnapshot();
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != SnapshotHeader::Magic || header.version != SnapshotHeader::Version ||
+            header.sizeOfSizeT != sizeof(size_t) || header.sizeOfValue != sizeof(value_type) ||
+            header.alignOfValue != alignof(value_type) || header.size > size ||
+            !isValidLayout(header)) {
+            throwInvalidSnapshot();
+        }
+        mNumElements = static_cast<size_t>(header.numElements);
+        if (0 == header.numBuckets) {
+            return;
+        }
+        auto const* bytes = static_cast<char const*>(data);
+        mKeyVals = reinterpret_cast<value_type const*>(bytes + header.nodesOffset);
+        mInfo = reinterpret_cast<uint8_t const*>(bytes + header.infoOffset);
+        mNumBuckets = static_cast<size_t>(header.numBuckets);
+        mInfoInc = header.infoInc;
+        mInfoHashShift = header.infoHashShift;
+        if (reinterpret_cast<uintptr_t>(mKeyVals) % alignof(value_type) != 0 ||
+            mInfo[header.numElementsWithBuffer] != 1) {
+            // find() stops at the sentinel, which is the only bound of its probing
+            throwInvalidSnapshot();
+        }
+        for (size_t i = 0; i < header.numElementsWithBuffer; ++i) {
+            if (mInfo[i] != 0) {
+                if (hashKey(mKeyVals[i].first) != header.hashCheck) {
+                    throwInvalidSnapshot();
+                }
+                break;
+            }
+        }
+    }
+
+    // Pointer to the element with the given key, or nullptr if not found.
+    ROBIN_HOOD(NODISCARD) value_type const* find(const key_type& key) const {
+        ROBIN_HOOD_TRACE(this)
+        if (0 == mNumBuckets) {
+            return nullptr;
+        }
+        // as in Table::keyToIdx() and Table::findIdx()
+        auto const h = hashKey(key);
+        auto info = mInfoInc + static_cast<InfoType>((h & InfoMask) >> mInfoHashShift);
+        auto idx = static_cast<size_t>(
+            (static_cast<uint64_t>(static_cast<uint32_t>(h)) * static_cast<uint64_t>(mNumBuckets)) >>
+            32U);
+        do {
+            if (info == mInfo[idx] && WKeyEqual::operator()(key, mKeyVals[idx].first)) {
+                return mKeyVals + idx;
+            }
+            ++idx;
+            info += mInfoInc;
+        } while (info <= mInfo[idx]);
+        return nullptr;
+    }
+
+    ROBIN_HOOD(NODISCARD) size_t count(const key_type& key) const {
+        return find(key) == nullptr ? 0 : 1;
+    }
+
+    ROBIN_HOOD(NODISCARD) bool contains(const key_type& key) const {
+        return find(key) != nullptr;
+    }
+
+    ROBIN_HOOD(NODISCARD) size_type size() const noexcept {
+        return mNumElements;
+    }
+
+    ROBIN_HOOD(NODISCARD) bool empty() const noexcept {
+        return 0 == mNumElements;
+    }
+
+private:
+    ROBIN_HOOD(NODISCARD) size_t hashKey(const key_type& key) const {
+        using Mix =
+            typename std::conditional<std::is_same<::robin_hood::hash<key_type>, hasher>::value,
+                                      ::robin_hood::detail::identity_hash<size_t>,
+                                      ::robin_hood::hash<size_t>>::type;
+        return Mix{}(WHash::operator()(key));
+    }
+
+    // Whether the header describes the layout written by Table::writeSnapshot() within
+    // header.size bytes, which is already checked against the data size. The sizes are checked
+    // by division, so that corrupt values cannot overflow.
+    ROBIN_HOOD(NODISCARD) static bool isValidLayout(SnapshotHeader const& header) noexcept {
+        auto const nodesOffset = SnapshotHeader::calcNodesOffset(alignof(value_type));
+        if (header.size < sizeof(SnapshotHeader) || header.nodesOffset != nodesOffset) {
+            return false;
+        }
+        if (0 == header.numBuckets) {
+            return 0 == header.numElements && header.numElementsWithBuffer == 0 &&
+                   header.infoOffset == nodesOffset;
+        }
+        // info starts at mInfoInc and is halved down to 2, so probing always ends at the
+        // sentinel, whose value is 1. Buckets are a 32 bit multiply-shift of the hash.
+        if (header.infoInc < 2 || header.infoInc > (1U << InfoNumBits) ||
+            header.infoHashShift > InfoNumBits || header.numElements > header.numBuckets ||
+            header.numBuckets > (UINT64_C(1) << 32U) ||
+            header.numElementsWithBuffer < header.numBuckets) {
+            return false;
+        }
+        auto const available = header.size - nodesOffset;
+        if (header.numElementsWithBuffer > available / sizeof(value_type)) {
+            return false;
+        }
+        auto const nodesSize = header.numElementsWithBuffer * sizeof(value_type);
+        // the info bytes are followed by the sentinel and padding up to a uint64_t
+        return header.infoOffset == nodesOffset + nodesSize &&
+               available - nodesSize >= header.numElementsWithBuffer &&
+               available - nodesSize - header.numElementsWithBuffer >= sizeof(uint64_t);
+    }
+
+    ROBIN_HOOD(NOINLINE) void throwInvalidSnapshot() const {
+#if ROBIN_HOOD(HAS_EXCEPTIONS)
+        throw std::runtime_error("robin_hood::mapped_flat_map invalid snapshot");
+#else
+        abort();
+#endif
+    }
+
+    value_type const* mKeyVals = nullptr;
+    uint8_t const* mInfo = nullptr;
+    size_t mNumElements = 0;
+    size_t mNumBuckets = 0;
+    InfoType mInfoInc = 0;
+    InfoType mInfoHashShift = 0;
+};
+
+} // namespace detail
+
+// map
+
+template <typename Key, typename T, typename Hash = hash<Key>,
+          typename KeyEqual = std::equal_to<Key>, size_t MaxLoadFactor100 = 80,
+          typename Allocator = MallocAllocator>
+using unordered_flat_map = detail::Table<true, MaxLoadFactor100, Key, T, Hash, KeyEqual, Allocator>;
+
+template <typename Key, typename T, typename Hash = hash<Key>,
+          typename KeyEqual = std::equal_to<Key>, size_t MaxLoadFactor100 = 80,
+          typename Allocator = MallocAllocator>
+using unordered_node_map = detail::Table<false, MaxLoadFactor100, Key, T, Hash, KeyEqual, Allocator>;
 
 template <typename Key, typename T, typename Hash = hash<Key>,
-          typename KeyEqual = std::equal_to<Key>, size_t MaxLoadFactor100 = 80>
-using unordered_flat_map = detail::Table<true, MaxLoadFactor100, Key, T, Hash, KeyEqual>;
+          typename KeyEqual = std::equal_to<Key>, size_t MaxLoadFactor100 = 87,
+          typename Allocator = MallocAllocator>
+using unordered_swiss_map = detail::SwissTable<MaxLoadFactor100, Key, T, Hash, KeyEqual, Allocator>;
 
 template <typename Key, typename T, typename Hash = hash<Key>,
-          typename KeyEqual = std::equal_to<Key>, size_t MaxLoadFactor100 = 80>
-using unordered_node_map = detail::Table<false, MaxLoadFactor100, Key, T, Hash, KeyEqual>;
+          typename KeyEqual = std::equal_to<Key>>
+using mapped_flat_map = detail::MappedTable<Key, T, Hash, KeyEqual>;
 
 template <typename Key, typename T, typename Hash = hash<Key>,
-          typename KeyEqual = std::equal_to<Key>, size_t MaxLoadFactor100 = 80>
+          typename KeyEqual = std::equal_to<Key>, size_t MaxLoadFactor100 = 80,
+          typename Allocator = MallocAllocator>
 using unordered_map =
     detail::Table<sizeof(robin_hood::pair<Key, T>) <= sizeof(size_t) * 6 &&
                       std::is_nothrow_move_constructible<robin_hood::pair<Key, T>>::value &&
                       std::is_nothrow_move_assignable<robin_hood::pair<Key, T>>::value,
-                  MaxLoadFactor100, Key, T, Hash, KeyEqual>;
+                  MaxLoadFactor100, Key, T, Hash, KeyEqual, Allocator>;
 
 // set
 
 template <typename Key, typename Hash = hash<Key>, typename KeyEqual = std::equal_to<Key>,
-          size_t MaxLoadFactor100 = 80>
-using unordered_flat_set = detail::Table<true, MaxLoadFactor100, Key, void, Hash, KeyEqual>;
+          size_t MaxLoadFactor100 = 80, typename Allocator = MallocAllocator>
+using unordered_flat_set = detail::Table<true, MaxLoadFactor100, Key, void, Hash, KeyEqual, Allocator>;
 
 template <typename Key, typename Hash = hash<Key>, typename KeyEqual = std::equal_to<Key>,
-          size_t MaxLoadFactor100 = 80>
-using unordered_node_set = detail::Table<false, MaxLoadFactor100, Key, void, Hash, KeyEqual>;
+          size_t MaxLoadFactor100 = 80, typename Allocator = MallocAllocator>
+using unordered_node_set = detail::Table<false, MaxLoadFactor100, Key, void, Hash, KeyEqual, Allocator>;
 
 template <typename Key, typename Hash = hash<Key>, typename KeyEqual = std::equal_to<Key>,
-          size_t MaxLoadFactor100 = 80>
+          size_t MaxLoadFactor100 = 80, typename Allocator = MallocAllocator>
 using unordered_set = detail::Table<sizeof(Key) <= sizeof(size_t) * 6 &&
                                         std::is_nothrow_move_constructible<Key>::value &&
                                         std::is_nothrow_move_assignable<Key>::value,
-                                    MaxLoadFactor100, Key, void, Hash, KeyEqual>;
+                                    MaxLoadFactor100, Key, void, Hash, KeyEqual, Allocator>;
 
 } // namespace robin_hood
 
@@ -5,16 +5,28 @@
 
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
 #include "ext/robin_hood.h"
+#include "perfcounters.h"
+#include "reclaimer.h"
+#include "slotmap.h"
 
 using std::array;
 using std::string;
@@ -26,6 +38,25 @@ template <typename K, typename V>
 using unordered_flat_map = robin_hood::unordered_flat_map<K, V>;
 template <typename K, typename V>
 using unordered_node_map = robin_hood::unordered_node_map<K, V>;
+template <typename K, typename V>
+using unordered_swiss_map = robin_hood::unordered_swiss_map<K, V>;
+
+// Transparent hash for string keys, so that maps can be searched with
+// string_view without building a temporary string. Hashes match
+// robin_hood::hash<std::string>.
+struct string_hash {
+  using is_transparent = void;
+  size_t operator()(std::string_view str) const noexcept {
+    return robin_hood::hash<std::string_view>{}(str);
+  }
+};
+template <typename K, typename V>
+using transparent_flat_map =
+    robin_hood::unordered_flat_map<K, V, string_hash, std::equal_to<>>;
+template <typename K, typename V>
+using transparent_node_map =
+    robin_hood::unordered_node_map<K, V, string_hash, std::equal_to<>>;
+
 #ifdef USE_ABSEIL
 template <typename K, typename V>
 using flat_hash_map = absl::flat_hash_map<K, V>;
@@ -33,6 +64,83 @@ template <typename K, typename V>
 using node_hash_map = absl::node_hash_map<K, V>;
 #endif
 
+// Hash map safe for concurrent use, made of Shards independently locked
+// robin_hood flat maps. The shard is picked from the high bits of the
+// robin_hood hash, so the low bits used inside each shard stay well mixed.
+// Values are only accessed under the shard lock, so lookups take a callback.
+template <typename K, typename V, size_t Shards = 64>
+struct sharded_flat_map {
+  static_assert((Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+
+  // Calls func(value) under a shared lock if key exists. Returns whether found.
+  template <typename Func>
+  bool find(const K& key, Func&& func) const {
+    auto& shard = get_shard(key);
+    auto  lock  = std::shared_lock{shard.mutex};
+    auto  it    = shard.map.find(key);
+    if (it == shard.map.end()) return false;
+    func(it->second);
+    return true;
+  }
+  // Inserts or replaces the value for key. Returns whether it was inserted.
+  template <typename Value>
+  bool insert_or_assign(const K& key, Value&& value) {
+    auto& shard = get_shard(key);
+    auto  lock  = std::unique_lock{shard.mutex};
+    return shard.map.insert_or_assign(key, std::forward<Value>(value)).second;
+  }
+  // Removes key. Returns the number of erased elements.
+  size_t erase(const K& key) {
+    auto& shard = get_shard(key);
+    auto  lock  = std::unique_lock{shard.mutex};
+    return shard.map.erase(key);
+  }
+  // Calls func(map) for each shard map while holding its shared lock.
+  template <typename Func>
+  void for_each_shard(Func&& func) const {
+    for (auto& shard : shards) {
+      auto lock = std::shared_lock{shard.mutex};
+      func(shard.map);
+    }
+  }
+  size_t size() const {
+    auto size = (size_t)0;
+    for_each_shard([&size](auto& map) { size += map.size(); });
+    return size;
+  }
+
+ private:
+  // padded to a cache line, so that locking one shard does not invalidate
+  // the lock of its neighbours
+  struct alignas(64) shard_type {
+    mutable std::shared_mutex            mutex;
+    robin_hood::unordered_flat_map<K, V> map;
+  };
+  array<shard_type, Shards> shards;
+
+  shard_type& get_shard(const K& key) {
+    return shards[get_shard_index(key)];
+  }
+  const shard_type& get_shard(const K& key) const {
+    return shards[get_shard_index(key)];
+  }
+  static size_t get_shard_index(const K& key) {
+    if constexpr (Shards == 1) {
+      return 0;
+    } else {
+      // robin_hood::hash may return only 32 bits, so remix before taking the
+      // high bits
+      auto hash = (uint64_t)robin_hood::hash<K>{}(key) * 0x9E3779B97F4A7C15ull;
+      return (size_t)(hash >> (64 - shard_bits()));
+    }
+  }
+  static constexpr int shard_bits() {
+    auto bits = 0;
+    while (((size_t)1 << bits) < Shards) bits++;
+    return bits;
+  }
+};
+
 struct timer {
   timer(string msg) : start{get_time()}, msg{msg} {}
   int64_t elapsed() { return get_time() - start; }
@@ -49,14 +157,415 @@ struct timer {
     sprintf(buffer, "%02d:%02d:%02d.%03d", hours, mins, secs, msecs);
     return buffer;
   }
-  ~timer() { printf("%s in %s\n", msg.c_str(), elapsedf().c_str()); }
+  string countersf() { return counters.format(); }
+  ~timer() {
+    printf("%s in %s%s\n", msg.c_str(), elapsedf().c_str(),
+        countersf().c_str());
+  }
   static int64_t get_time() {
     return std::chrono::high_resolution_clock::now().time_since_epoch().count();
   }
 
  private:
-  int64_t start = 0;
-  string  msg   = "";
+  perf_counters counters = {};  // opened before the clock starts
+  int64_t       start    = 0;
+  string        msg      = "";
+};
+
+// Map from integer keys to values, for keys that are mostly dense in [0, N),
+// like the shape and instance ids of the scenes. Values are stored at their
+// key in one array, with a bitmap of the keys present, so lookups neither hash
+// nor compare keys, and keys are not stored. The dense range is declared with
+// reserve(n), or grown on insert while at least a quarter of it stays used.
+// Other keys, e.g. negative or far away ones, go to a robin_hood map.
+// Iterators yield pair<const K, V&> by value, so structured bindings need
+// `auto` or `auto&&`.
+template <typename K, typename V>
+struct dense_int_map {
+  static_assert(std::is_integral_v<K>, "dense_int_map needs integer keys");
+
+  using fallback_map = robin_hood::unordered_map<K, V>;
+
+  template <bool is_const>
+  struct iterator_type {
+    using map_type = std::conditional_t<is_const, const dense_int_map,
+        dense_int_map>;
+    using fallback_iterator = std::conditional_t<is_const,
+        typename fallback_map::const_iterator, typename fallback_map::iterator>;
+    using value_type =
+        std::pair<const K, std::conditional_t<is_const, const V&, V&>>;
+    struct arrow_proxy {
+      value_type  value;
+      value_type* operator->() { return &value; }
+    };
+
+    value_type operator*() const {
+      if (bits) return {(K)index, map->values[index].value};
+      return {it->first, it->second};
+    }
+    arrow_proxy    operator->() const { return {**this}; }
+    iterator_type& operator++() {
+      if (!bits) {
+        ++it;
+        return *this;
+      }
+      // next key in the same bitmap word, without reloading it
+      bits &= bits - 1;
+      if (bits) {
+        index = index / word_bits * word_bits +
+                ROBIN_HOOD_COUNT_TRAILING_ZEROES(bits);
+      } else {
+        *this = map->make_iterator(
+            map->next_present((index / word_bits + 1) * word_bits));
+      }
+      return *this;
+    }
+    bool operator==(const iterator_type& other) const {
+      return index == other.index && it == other.it;
+    }
+    bool operator!=(const iterator_type& other) const {
+      return !(*this == other);
+    }
+
+    map_type* map   = nullptr;
+    size_t    index = 0;  // dense key, or capacity when in the fallback
+    // present keys from index on in its bitmap word, 0 in the fallback
+    size_t bits = 0;
+    // fallback.end() while in the dense range
+    fallback_iterator it = {};
+  };
+  using iterator       = iterator_type<false>;
+  using const_iterator = iterator_type<true>;
+
+  dense_int_map() = default;
+  dense_int_map(const dense_int_map& other) : fallback{other.fallback} {
+    resize_dense(other.capacity);
+    for (auto index = other.next_present(0); index < other.capacity;
+         index   = other.next_present(index + 1)) {
+      insert_dense(index, other.values[index].value);
+    }
+  }
+  dense_int_map(dense_int_map&& other) noexcept { swap(other); }
+  dense_int_map& operator=(dense_int_map other) noexcept {
+    swap(other);
+    return *this;
+  }
+  ~dense_int_map() { clear_dense(); }
+
+  // Value of key, inserted default constructed if not present.
+  V& operator[](K key) {
+    if (is_dense(key) && has((size_t)key)) return values[key].value;
+    return insert(key);
+  }
+
+  iterator find(K key) {
+    if (is_dense(key)) return has(key) ? make_iterator(key) : end();
+    auto it = fallback.find(key);
+    return it == fallback.end() ? end() : iterator{this, capacity, 0, it};
+  }
+  const_iterator find(K key) const {
+    if (is_dense(key)) return has(key) ? make_iterator(key) : end();
+    auto it = fallback.find(key);
+    return it == fallback.end() ? end() : const_iterator{this, capacity, 0, it};
+  }
+  bool contains(K key) const {
+    return is_dense(key) ? has(key) : fallback.contains(key);
+  }
+  size_t count(K key) const { return contains(key) ? 1 : 0; }
+
+  // Erases key. Returns the number of erased elements.
+  size_t erase(K key) {
+    if (!is_dense(key)) return fallback.erase(key);
+    if (!has(key)) return 0;
+    values[key].value.~V();
+    present[key / word_bits] &= ~((size_t)1 << (key % word_bits));
+    num_dense--;
+    return 1;
+  }
+
+  size_t size() const { return num_dense + fallback.size(); }
+  bool   empty() const { return size() == 0; }
+  // Declares the keys in [0, n) as dense.
+  void reserve(size_t n) {
+    if (n > capacity) resize_dense(n);
+  }
+  void clear() {
+    clear_dense();
+    fallback.clear();
+  }
+  void swap(dense_int_map& other) noexcept {
+    std::swap(values, other.values);
+    std::swap(present, other.present);
+    std::swap(capacity, other.capacity);
+    std::swap(num_dense, other.num_dense);
+    std::swap(fallback, other.fallback);
+  }
+
+  iterator begin() { return make_iterator(next_present(0)); }
+  iterator end() { return {this, capacity, 0, fallback.end()}; }
+  const_iterator begin() const { return make_iterator(next_present(0)); }
+  const_iterator end() const { return {this, capacity, 0, fallback.end()}; }
+
+ private:
+  // storage for a value that is constructed only if its key is present
+  union slot {
+    slot() {}
+    ~slot() {}
+    V value;
+  };
+  static constexpr size_t word_bits    = sizeof(size_t) * 8;
+  static constexpr size_t min_capacity = 64;
+
+  std::unique_ptr<slot[]> values    = nullptr;
+  vector<size_t>          present   = {};  // one bit per key in [0, capacity)
+  size_t                  capacity  = 0;
+  size_t                  num_dense = 0;  // keys in [0, capacity)
+  fallback_map            fallback  = fallback_map{};
+
+  // Inserts a default constructed value, kept out of operator[] so that
+  // lookups of present keys are inlined.
+  V& insert(K key) {
+    if (!is_dense(key) && !grow_dense(key)) return fallback[key];
+    auto index = (size_t)key;
+    if (!has(index)) insert_dense(index, V{});
+    return values[index].value;
+  }
+  bool is_dense(K key) const {
+    if constexpr (std::is_signed_v<K>) {
+      if (key < 0) return false;
+    }
+    return (size_t)key < capacity;
+  }
+  bool has(size_t index) const {
+    return (present[index / word_bits] >> (index % word_bits)) & 1;
+  }
+  // First present key from index on, or capacity if none.
+  size_t next_present(size_t index) const {
+    while (index < capacity) {
+      auto word = present[index / word_bits] >> (index % word_bits);
+      if (word) return index + ROBIN_HOOD_COUNT_TRAILING_ZEROES(word);
+      index = (index / word_bits + 1) * word_bits;
+    }
+    return capacity;
+  }
+  size_t bits_from(size_t index) const {
+    if (index >= capacity) return 0;
+    auto shift = index % word_bits;
+    return present[index / word_bits] >> shift << shift;
+  }
+  // Iterator at the dense key index, or at the first fallback element if index
+  // is capacity. fallback.begin() scans the fallback buckets, so it is only
+  // taken when leaving the dense range, not at every bitmap word.
+  iterator make_iterator(size_t index) {
+    return {this, index, bits_from(index),
+        index < capacity ? fallback.end() : fallback.begin()};
+  }
+  const_iterator make_iterator(size_t index) const {
+    return {this, index, bits_from(index),
+        index < capacity ? fallback.end() : fallback.begin()};
+  }
+  template <typename Value>
+  void insert_dense(size_t index, Value&& value) {
+    new (&values[index].value) V(std::forward<Value>(value));
+    present[index / word_bits] |= (size_t)1 << (index % word_bits);
+    num_dense++;
+  }
+  // Grows the dense range to include key if it would stay at least a quarter
+  // full, otherwise an array would take more memory than a hash map.
+  bool grow_dense(K key) {
+    if constexpr (std::is_signed_v<K>) {
+      if (key < 0) return false;
+    }
+    auto new_capacity = std::max({(size_t)key + 1, capacity * 2, min_capacity});
+    if (new_capacity > min_capacity && new_capacity > 4 * (size() + 1))
+      return false;
+    resize_dense(new_capacity);
+    return true;
+  }
+  // Moves the values into an array of new_capacity, with the fallback keys
+  // that are now in range.
+  void resize_dense(size_t new_capacity) {
+    auto old_values = std::move(values);
+    auto old_present = std::move(present);
+    auto old_capacity = capacity;
+    values            = std::make_unique<slot[]>(new_capacity);
+    present           = vector<size_t>((new_capacity + word_bits - 1) / word_bits);
+    capacity          = new_capacity;
+    num_dense         = 0;
+    for (auto index = (size_t)0; index < old_capacity; index++) {
+      if (!((old_present[index / word_bits] >> (index % word_bits)) & 1))
+        continue;
+      insert_dense(index, std::move(old_values[index].value));
+      old_values[index].value.~V();
+    }
+    for (auto it = fallback.begin(); it != fallback.end();) {
+      if (is_dense(it->first)) {
+        insert_dense((size_t)it->first, std::move(it->second));
+        it = fallback.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  void clear_dense() {
+    for (auto index = next_present(0); index < capacity;
+         index      = next_present(index + 1)) {
+      values[index].value.~V();
+    }
+    std::fill(present.begin(), present.end(), 0);
+    num_dense = 0;
+  }
+};
+
+// Resident and peak resident memory in MB, read from /proc on Linux and 0
+// elsewhere. The peak can be reset to the resident size before each test.
+#ifdef __linux__
+#include <malloc.h>
+double read_proc_status(const string& field) {
+  auto fs   = std::ifstream{"/proc/self/status"};
+  auto line = string{};
+  while (std::getline(fs, line)) {
+    if (line.compare(0, field.size(), field) == 0)
+      return atof(line.c_str() + field.size()) / 1024;
+  }
+  return 0;
+}
+double get_resident_memory() { return read_proc_status("VmRSS:"); }
+double get_peak_memory() { return read_proc_status("VmHWM:"); }
+// Freed heap memory is first returned to the system, so that it is not reused
+// by the next test. Resetting needs Linux 4.0 or later, otherwise the peak is
+// the one of the process.
+void reset_peak_memory() {
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+  std::ofstream{"/proc/self/clear_refs"} << "5";
+}
+#else
+double get_resident_memory() { return 0; }
+double get_peak_memory() { return 0; }
+void   reset_peak_memory() {}
+#endif
+
+// Read-only memory map of a whole file, or a copy of it in memory on
+// platforms without mmap. Data is empty if the file cannot be opened.
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+struct mapped_file {
+  mapped_file(const string& filename) {
+    auto fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      auto ptr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr != MAP_FAILED) {
+        data = ptr;
+        size = info.st_size;
+      }
+    }
+    close(fd);
+  }
+  ~mapped_file() {
+    if (data) munmap((void*)data, size);
+  }
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  const void* data = nullptr;
+  size_t      size = 0;
+};
+#else
+struct mapped_file {
+  mapped_file(const string& filename) {
+    auto fs = std::ifstream{filename, std::ios::binary | std::ios::ate};
+    if (!fs) return;
+    buffer.resize(((size_t)fs.tellg() + 7) / 8);
+    size = (size_t)fs.tellg();
+    fs.seekg(0);
+    fs.read((char*)buffer.data(), size);
+    data = buffer.data();
+  }
+
+  const void*      data   = nullptr;
+  size_t           size   = 0;
+  vector<uint64_t> buffer = {};  // 8 byte aligned
+};
+#endif
+
+// robin_hood allocator that takes memory from a std::pmr::memory_resource.
+struct pmr_allocator {
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+  void* allocate(size_t bytes) {
+    return resource->allocate(bytes, alignof(std::max_align_t));
+  }
+  void deallocate(void* ptr, size_t bytes) {
+    resource->deallocate(ptr, bytes, alignof(std::max_align_t));
+  }
+};
+template <typename K, typename V>
+using pmr_flat_map = robin_hood::unordered_flat_map<K, V, robin_hood::hash<K>,
+    std::equal_to<K>, 80, pmr_allocator>;
+template <typename K, typename V>
+using pmr_node_map = robin_hood::unordered_node_map<K, V, robin_hood::hash<K>,
+    std::equal_to<K>, 80, pmr_allocator>;
+template <typename K, typename V>
+using pmr_swiss_map = robin_hood::unordered_swiss_map<K, V, robin_hood::hash<K>,
+    std::equal_to<K>, 87, pmr_allocator>;
+
+// Memory resource that maps allocations of at least 2 MB on huge pages, to
+// reduce TLB misses: explicit ones (MAP_HUGETLB) if the system reserved any,
+// otherwise transparent ones, requested with madvise on a 2 MB aligned
+// mapping. Smaller allocations, and all of them outside Linux, go upstream.
+struct huge_page_resource : std::pmr::memory_resource {
+  static constexpr size_t page_size = 2 << 20;
+
+  size_t hugetlb_bytes = 0;  // mapped on explicit huge pages
+  size_t thp_bytes     = 0;  // advised for transparent huge pages
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+#ifdef __linux__
+    if (bytes >= page_size && alignment <= page_size) {
+      auto size  = (bytes + page_size - 1) / page_size * page_size;
+      auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
+      auto ptr   = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+          flags | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) {
+        hugetlb_bytes += size;
+        return ptr;
+      }
+      // map one more page and trim it, to align to the huge page size
+      auto raw = (char*)mmap(
+          nullptr, size + page_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+      if (raw == MAP_FAILED) throw std::bad_alloc{};
+      auto aligned = (char*)(((uintptr_t)raw + page_size - 1) & ~(page_size - 1));
+      if (aligned != raw) munmap(raw, aligned - raw);
+      munmap(aligned + size, raw + page_size - aligned);
+      madvise(aligned, size, MADV_HUGEPAGE);
+      thp_bytes += size;
+      return aligned;
+    }
+#endif
+    return upstream->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+#ifdef __linux__
+    if (bytes >= page_size && alignment <= page_size) {
+      munmap(ptr, (bytes + page_size - 1) / page_size * page_size);
+      return;
+    }
+#endif
+    upstream->deallocate(ptr, bytes, alignment);
+  }
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream = std::pmr::new_delete_resource();
 };
 
 using float3 = array<float, 3>;
@@ -69,6 +578,29 @@ inline float3& operator+=(float3& a, const float3& b) {
 
 const auto repetitions = 100;
 
+// Reclaimer of the scenes of the values tests, set with `--reclaim`. If set,
+// "del" is the pause of the caller, that only retires the scene, and
+// "reclaim" the time until the scene is freed. The scenes with pointers
+// retire each shape and instance from their destructors, so that an
+// incremental reclaimer frees a few of them per tick.
+reclaimer* scene_reclaimer = nullptr;
+
+// Deletes object now, or later if there is a scene reclaimer.
+template <typename T>
+void delete_deferred(T* object) {
+  if (scene_reclaimer) {
+    scene_reclaimer->retire(std::unique_ptr<T>{object});
+  } else {
+    delete object;
+  }
+}
+// Waits until the scene of a test is freed, after its del phase.
+void wait_reclaimed(const string& name) {
+  if (!scene_reclaimer) return;
+  auto timer = ::timer{name + " reclaim"};
+  scene_reclaimer->wait();
+}
+
 float3 test_raw_pointers(const string& name, const vector<float3>& positions,
     const vector<int>& shapes) {
   struct Shape {
@@ -81,8 +613,8 @@ float3 test_raw_pointers(const string& name, const vector<float3>& positions,
     vector<Shape*>    shapes    = {};
     vector<Instance*> instances = {};
     ~Scene() {
-      for (auto shape : shapes) delete shape;
-      for (auto instance : instances) delete instance;
+      for (auto shape : shapes) delete_deferred(shape);
+      for (auto instance : instances) delete_deferred(instance);
     }
   };
   auto scene = (Scene*)nullptr;
@@ -113,8 +645,9 @@ float3 test_raw_pointers(const string& name, const vector<float3>& positions,
   {
     // cleanup
     auto timer = ::timer{name + " del"};
-    delete scene;
+    delete_deferred(scene);
   }
+  wait_reclaimed(name);
   return sum;
 }
 
@@ -130,8 +663,8 @@ float3 test_vector_pointers(const string& name, const vector<float3>& positions,
     vector<Shape*>    shapes    = {};
     vector<Instance*> instances = {};
     ~Scene() {
-      for (auto shape : shapes) delete shape;
-      for (auto instance : instances) delete instance;
+      for (auto shape : shapes) delete_deferred(shape);
+      for (auto instance : instances) delete_deferred(instance);
     }
   };
   auto scene = (Scene*)nullptr;
@@ -162,8 +695,9 @@ float3 test_vector_pointers(const string& name, const vector<float3>& positions,
   {
     // cleanup
     auto timer = ::timer{name + " del"};
-    delete scene;
+    delete_deferred(scene);
   }
+  wait_reclaimed(name);
   return sum;
 }
 
@@ -207,8 +741,9 @@ float3 test_vector_values(const string& name, const vector<float3>& positions,
   {
     // cleanup
     auto timer = ::timer{name + " del"};
-    delete scene;
+    delete_deferred(scene);
   }
+  wait_reclaimed(name);
   return sum;
 }
 
@@ -225,8 +760,8 @@ float3 test_map_pointers(const string& name, const vector<float3>& positions,
     hash_map<int, Shape*>    shapes;
     hash_map<int, Instance*> instances;
     ~Scene() {
-      for (auto [_, shape] : shapes) delete shape;
-      for (auto [_, instance] : instances) delete instance;
+      for (auto [_, shape] : shapes) delete_deferred(shape);
+      for (auto [_, instance] : instances) delete_deferred(instance);
     }
   };
   auto scene = (Scene*)nullptr;
@@ -259,8 +794,9 @@ float3 test_map_pointers(const string& name, const vector<float3>& positions,
   {
     // cleanup
     auto timer = ::timer{name + " del"};
-    delete scene;
+    delete_deferred(scene);
   }
+  wait_reclaimed(name);
   return sum;
 }
 
@@ -299,7 +835,7 @@ float3 test_map_values(const string& name, const vector<float3>& positions,
     auto timer = ::timer{name + " sum"};
     for (auto count = 0; count < repetitions; count++) {
       sum = float3{0, 0, 0};
-      for (auto& [_, instance] : scene->instances) {
+      for (auto&& [_, instance] : scene->instances) {
         sum += scene->shapes[instance.shape].positions[0];
       }
     }
@@ -307,12 +843,740 @@ float3 test_map_values(const string& name, const vector<float3>& positions,
   {
     // cleanup
     auto timer = ::timer{name + " del"};
-    delete scene;
+    delete_deferred(scene);
   }
+  wait_reclaimed(name);
   return sum;
 }
 
+float3 test_slotmap_values(const string& name, const vector<float3>& positions,
+    const vector<int>& shapes) {
+  struct Shape {
+    vector<float3> positions = {};
+  };
+  struct Instance {
+    slot_map<Shape>::handle shape = {};
+  };
+  struct Scene {
+    slot_map<Shape>    shapes    = {};
+    slot_map<Instance> instances = {};
+  };
+  auto scene = (Scene*)nullptr;
+  auto sum   = float3{0, 0, 0};
+  {
+    // create
+    auto timer = ::timer{name + " new"};
+    scene      = new Scene{};
+    auto handles = vector<slot_map<Shape>::handle>{};
+    for (auto position : positions) {
+      handles.push_back(scene->shapes.insert(Shape{{position}}));
+    }
+    for (auto shape : shapes) {
+      scene->instances.insert(Instance{handles[shape]});
+    }
+  }
+  {
+    // lookup
+    auto timer = ::timer{name + " sum"};
+    for (auto count = 0; count < repetitions; count++) {
+      sum = float3{0, 0, 0};
+      for (auto& instance : scene->instances) {
+        sum += scene->shapes[instance.shape].positions[0];
+      }
+    }
+  }
+  {
+    // cleanup
+    auto timer = ::timer{name + " del"};
+    delete_deferred(scene);
+  }
+  wait_reclaimed(name);
+  return sum;
+}
+
+// Erase-heavy workload: half of the shapes are erased in scattered order,
+// then the remaining ones are iterated. Vectors erase by position, which
+// shifts the following shapes and invalidates their indices, while maps
+// and slot maps erase by id or handle.
+float3 test_vector_erase(const string& name, const vector<float3>& positions,
+    const vector<int>& erases) {
+  struct Shape {
+    vector<float3> positions = {};
+  };
+  auto shapes = vector<Shape>{};
+  for (auto position : positions) shapes.push_back({{position}});
+  {
+    auto timer = ::timer{name + " erase"};
+    for (auto shape : erases) {
+      shapes.erase(shapes.begin() + shape % (int)shapes.size());
+    }
+  }
+  auto sum = float3{0, 0, 0};
+  {
+    auto timer = ::timer{name + " iter "};
+    for (auto count = 0; count < repetitions; count++) {
+      sum = float3{0, 0, 0};
+      for (auto& shape : shapes) sum += shape.positions[0];
+    }
+  }
+  return sum;
+}
+
+template <template <typename...> typename hash_map>
+float3 test_map_erase(const string& name, const vector<float3>& positions,
+    const vector<int>& erases) {
+  struct Shape {
+    vector<float3> positions = {};
+  };
+  auto shapes = hash_map<int, Shape>{};
+  for (auto shape_id = 0; shape_id < (int)positions.size(); shape_id++) {
+    shapes[shape_id] = Shape{{positions[shape_id]}};
+  }
+  {
+    auto timer = ::timer{name + " erase"};
+    for (auto shape : erases) shapes.erase(shape);
+  }
+  auto sum = float3{0, 0, 0};
+  {
+    auto timer = ::timer{name + " iter "};
+    for (auto count = 0; count < repetitions; count++) {
+      sum = float3{0, 0, 0};
+      for (auto& [_, shape] : shapes) sum += shape.positions[0];
+    }
+  }
+  return sum;
+}
+
+float3 test_slotmap_erase(const string& name, const vector<float3>& positions,
+    const vector<int>& erases) {
+  struct Shape {
+    vector<float3> positions = {};
+  };
+  auto shapes  = slot_map<Shape>{};
+  auto handles = vector<slot_map<Shape>::handle>{};
+  for (auto position : positions) {
+    handles.push_back(shapes.insert(Shape{{position}}));
+  }
+  {
+    auto timer = ::timer{name + " erase"};
+    for (auto shape : erases) shapes.erase(handles[shape]);
+  }
+  auto sum = float3{0, 0, 0};
+  {
+    auto timer = ::timer{name + " iter "};
+    for (auto count = 0; count < repetitions; count++) {
+      sum = float3{0, 0, 0};
+      for (auto& shape : shapes) sum += shape.positions[0];
+    }
+  }
+  return sum;
+}
+
+// Whether a map can be searched with keys of other types.
+template <typename Map, typename = void>
+struct is_transparent_map : std::false_type {};
+template <typename Map>
+struct is_transparent_map<Map,
+    std::void_t<typename Map::hasher::is_transparent>> : std::true_type {};
+
+// Finds key in a string map, through a temporary string if the map is not
+// transparent.
+template <typename Map>
+auto find_view(const Map& map, std::string_view key) {
+  if constexpr (is_transparent_map<Map>::value) {
+    return map.find(key);
+  } else {
+    return map.find(string{key});
+  }
+}
+
+// Shapes keyed by name, as asset names or paths. Instances look shapes up by
+// name, either with the string keys themselves or with string_views into one
+// buffer, as for names parsed from a file. Maps that are not transparent
+// build a temporary string for each string_view lookup, which allocates for
+// names longer than the small string buffer.
+template <template <typename...> typename hash_map>
+float3 test_map_strings(const string& name, const vector<float3>& positions,
+    const vector<string>& names, const vector<int>& shapes) {
+  auto map = hash_map<string, int>{};
+  {
+    // create
+    auto timer = ::timer{name + " new   "};
+    for (auto shape_id = 0; shape_id < (int)names.size(); shape_id++) {
+      map[names[shape_id]] = shape_id;
+    }
+  }
+  auto buffer = string{};
+  for (auto shape : shapes) buffer += names[shape];
+  auto views  = vector<std::string_view>{};
+  auto offset = (size_t)0;
+  for (auto shape : shapes) {
+    views.push_back(
+        std::string_view{buffer}.substr(offset, names[shape].size()));
+    offset += names[shape].size();
+  }
+  auto sum = float3{0, 0, 0};
+  {
+    // lookup with the key type, summed over all repetitions and both
+    // lookup kinds, so that no loop is optimized away
+    auto timer = ::timer{name + " string"};
+    for (auto count = 0; count < repetitions; count++) {
+      for (auto shape : shapes) {
+        sum += positions[map.find(names[shape])->second];
+      }
+    }
+  }
+  {
+    // lookup with string_view
+    auto timer = ::timer{name + " view  "};
+    for (auto count = 0; count < repetitions; count++) {
+      for (auto view : views) sum += positions[find_view(map, view)->second];
+    }
+  }
+  return sum;
+}
+
+// Thread counts used by the multi-threaded tests: 1, 2, 4, ... max_threads.
+vector<int> get_thread_counts(int max_threads) {
+  auto thread_counts = vector<int>{};
+  for (auto count = 1; count < max_threads; count *= 2) {
+    thread_counts.push_back(count);
+  }
+  thread_counts.push_back(max_threads);
+  return thread_counts;
+}
+
+// Same scene as test_map_values, but the lookup phase splits the instances
+// across threads that read the shared maps concurrently. Runs with 1, 2, 4, ...
+// up to max_threads and reports lookup throughput and scaling vs one thread.
+template <template <typename...> typename hash_map>
+float3 test_map_concurrent(const string& name, const vector<float3>& positions,
+    const vector<int>& shapes, int max_threads) {
+  struct Shape {
+    vector<float3> positions = {};
+  };
+  struct Instance {
+    int shape = -1;
+  };
+  struct Scene {
+    hash_map<int, Shape>    shapes;
+    hash_map<int, Instance> instances;
+  };
+  auto scene = new Scene();
+  for (auto shape_id = 0; shape_id < (int)positions.size(); shape_id++) {
+    scene->shapes[shape_id].positions = {positions[shape_id]};
+  }
+  for (auto instance_id = 0; instance_id < (int)shapes.size(); instance_id++) {
+    scene->instances[instance_id].shape = shapes[instance_id];
+  }
+  // only const lookups are allowed from multiple threads
+  auto& cscene        = (const Scene&)*scene;
+  auto  num_instances = (int)shapes.size();
+  auto  sum           = float3{0, 0, 0};
+  auto  base_rate     = 0.0;
+  for (auto num_threads : get_thread_counts(max_threads)) {
+    auto sums    = vector<float3>(num_threads);
+    auto threads = vector<std::thread>{};
+    auto start   = timer::get_time();
+    for (auto tid = 0; tid < num_threads; tid++) {
+      threads.emplace_back([&, tid]() {
+        auto first = (int)((int64_t)num_instances * tid / num_threads);
+        auto last  = (int)((int64_t)num_instances * (tid + 1) / num_threads);
+        auto tsum  = float3{0, 0, 0};
+        for (auto count = 0; count < repetitions; count++) {
+          tsum = float3{0, 0, 0};
+          for (auto instance_id = first; instance_id < last; instance_id++) {
+            auto& instance = cscene.instances.find(instance_id)->second;
+            tsum += cscene.shapes.find(instance.shape)->second.positions[0];
+          }
+        }
+        sums[tid] = tsum;
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    auto elapsed = timer::get_time() - start;
+    sum          = float3{0, 0, 0};
+    for (auto& tsum : sums) sum += tsum;
+    auto lookups = 2.0 * repetitions * num_instances;
+    auto rate    = lookups / (elapsed / 1e9) / 1e6;  // Mlookups/s
+    if (num_threads == 1) base_rate = rate;
+    printf("%s threads %3d: %8.1f Mlookups/s %5.2fx\n", name.c_str(),
+        num_threads, rate, rate / base_rate);
+  }
+  delete scene;
+  return sum;
+}
+
+// Mixed read/write workload on a shared shape map. Each thread walks its
+// slice of the instances, replacing the shape in write_percent of the steps
+// and summing its position otherwise. With one shard, this is a flat map
+// behind a single lock, as commonly done to share a map between threads.
+template <size_t Shards>
+float3 test_map_mixed(const string& name, const vector<float3>& positions,
+    const vector<int>& shapes, int max_threads, int write_percent) {
+  struct Shape {
+    vector<float3> positions = {};
+  };
+  auto scene = new sharded_flat_map<int, Shape, Shards>();
+  for (auto shape_id = 0; shape_id < (int)positions.size(); shape_id++) {
+    scene->insert_or_assign(shape_id, Shape{{positions[shape_id]}});
+  }
+  auto num_instances = (int)shapes.size();
+  auto sum           = float3{0, 0, 0};
+  auto base_rate     = 0.0;
+  for (auto num_threads : get_thread_counts(max_threads)) {
+    auto sums    = vector<float3>(num_threads);
+    auto threads = vector<std::thread>{};
+    auto start   = timer::get_time();
+    for (auto tid = 0; tid < num_threads; tid++) {
+      threads.emplace_back([&, tid]() {
+        auto first = (int)((int64_t)num_instances * tid / num_threads);
+        auto last  = (int)((int64_t)num_instances * (tid + 1) / num_threads);
+        auto tsum  = float3{0, 0, 0};
+        for (auto count = 0; count < repetitions; count++) {
+          tsum = float3{0, 0, 0};
+          for (auto instance_id = first; instance_id < last; instance_id++) {
+            auto shape_id = shapes[instance_id];
+            if ((instance_id * 7 + count) % 100 < write_percent) {
+              scene->insert_or_assign(shape_id, Shape{{positions[shape_id]}});
+            } else {
+              scene->find(shape_id,
+                  [&tsum](const Shape& shape) { tsum += shape.positions[0]; });
+            }
+          }
+        }
+        sums[tid] = tsum;
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    auto elapsed = timer::get_time() - start;
+    sum          = float3{0, 0, 0};
+    for (auto& tsum : sums) sum += tsum;
+    auto ops  = (double)repetitions * num_instances;
+    auto rate = ops / (elapsed / 1e9) / 1e6;  // Mops/s
+    if (num_threads == 1) base_rate = rate;
+    printf("%s threads %3d: %8.1f Mops/s %5.2fx\n", name.c_str(), num_threads,
+        rate, rate / base_rate);
+  }
+  delete scene;
+  return sum;
+}
+
+// Instance to shape lookups on a map of num_shapes entries, with one
+// operator[] per key versus find_batch, that hashes and prefetches a group of
+// keys before probing them. Only the robin_hood maps have find_batch.
+template <template <typename...> typename hash_map>
+float3 test_map_batch(const string& name, int num_shapes) {
+  auto shapes = hash_map<int, float3>{};
+  for (auto shape_id = 0; shape_id < num_shapes; shape_id++) {
+    shapes[shape_id] = {(float)shape_id, 0, 0};
+  }
+  auto instances = vector<int>(num_shapes);
+  for (auto instance_id = 0; instance_id < num_shapes; instance_id++) {
+    instances[instance_id] =
+        (int)((9187981ull * (size_t)instance_id) % (size_t)num_shapes);
+  }
+  // keep the number of lookups roughly constant across sizes
+  auto num_repetitions = std::max(1, repetitions * 10000 / num_shapes);
+  auto lookups         = (double)num_repetitions * num_shapes;
+  auto sum             = float3{0, 0, 0};
+  {
+    auto start = timer::get_time();
+    for (auto count = 0; count < num_repetitions; count++) {
+      sum = float3{0, 0, 0};
+      for (auto shape_id : instances) sum += shapes[shape_id];
+    }
+    auto elapsed = timer::get_time() - start;
+    printf("%s %9d operator[]:  %6.2f ns/lookup\n", name.c_str(), num_shapes,
+        elapsed / lookups);
+  }
+  {
+    const auto batch_size = 256;
+    auto results = vector<typename hash_map<int, float3>::iterator>(batch_size);
+    auto start   = timer::get_time();
+    for (auto count = 0; count < num_repetitions; count++) {
+      sum = float3{0, 0, 0};
+      for (auto first = 0; first < num_shapes; first += batch_size) {
+        auto num_keys = std::min(batch_size, num_shapes - first);
+        shapes.find_batch(instances.data() + first, num_keys, results.data());
+        for (auto i = 0; i < num_keys; i++) sum += results[i]->second;
+      }
+    }
+    auto elapsed = timer::get_time() - start;
+    printf("%s %9d find_batch: %6.2f ns/lookup\n", name.c_str(), num_shapes,
+        elapsed / lookups);
+  }
+  return sum;
+}
+
+// Cache-like workloads on a map of size keys, reported in ns/op: lookups where
+// hit_percent of the keys are present, lookups with Zipf-distributed key
+// popularity with the given exponent, and interleaved erases and inserts at
+// steady size, which exercise backward-shift deletion in robin_hood.
+template <template <typename...> typename hash_map>
+float3 test_map_workloads(
+    const string& name, int size, int hit_percent, double zipf) {
+  const auto num_ops = 1 << 22;
+  auto       rng     = std::mt19937_64{(uint64_t)size};
+  auto       map     = hash_map<int, float3>{};
+  for (auto key = 0; key < size; key++) map[key] = {(float)key, 0, 0};
+  auto& cmap   = (const hash_map<int, float3>&)map;
+  auto  check  = float3{0, 0, 0};
+  auto  report = [&](const string& workload, int64_t elapsed,
+                    const perf_counters& counters) {
+    printf("%s size %9d %-10s %8.2f ns/op%s\n", name.c_str(), size,
+        workload.c_str(), (double)elapsed / num_ops,
+        counters.format().c_str());
+  };
+  auto lookup = [&](const string& workload, const vector<int>& keys) {
+    auto counters = perf_counters{};
+    auto start    = timer::get_time();
+    for (auto key : keys) {
+      auto it = cmap.find(key);
+      if (it != cmap.end()) check += it->second;
+    }
+    report(workload, timer::get_time() - start, counters);
+  };
+  {
+    // misses are keys in [size, 2 size), which are never inserted
+    auto keys = vector<int>(num_ops);
+    for (auto& key : keys) {
+      auto hit = (int)(rng() % 100) < hit_percent;
+      key      = (int)(rng() % size) + (hit ? 0 : size);
+    }
+    lookup("hits " + std::to_string(hit_percent) + "%", keys);
+  }
+  {
+    // ranks are drawn from the Zipf cdf and scattered over the keys, so
+    // that popular keys are not neighbors in the table
+    auto cdf   = vector<double>(size);
+    auto total = 0.0;
+    for (auto rank = 0; rank < size; rank++) {
+      cdf[rank] = total += 1 / std::pow(rank + 1.0, zipf);
+    }
+    auto uniform = std::uniform_real_distribution<double>{0, total};
+    auto keys    = vector<int>(num_ops);
+    for (auto& key : keys) {
+      auto rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) -
+                  cdf.begin();
+      rank = std::min(rank, (ptrdiff_t)size - 1);
+      key  = (int)((9187981ull * (size_t)rank) % (size_t)size);
+    }
+    char workload[32];
+    snprintf(workload, sizeof(workload), "zipf %.2f", zipf);
+    lookup(workload, keys);
+  }
+  {
+    // the oldest key is erased and a new one inserted, one op each
+    auto counters = perf_counters{};
+    auto start    = timer::get_time();
+    for (auto step = 0; step < num_ops / 2; step++) {
+      map.erase(step);
+      map[size + step] = {(float)step, 0, 0};
+    }
+    report("churn", timer::get_time() - start, counters);
+    check += cmap.find(size + num_ops / 2 - 1)->second;
+  }
+  return check;
+}
+
+// Prints the robin_hood table statistics on one line: load, growth events,
+// memory and the probe distance histogram, as percentages of the elements.
+void print_table_stats(const string& name, const robin_hood::TableStats& stats) {
+  printf("%s: load %.2f/%.2f allowed %zu info+ %zu rehash %zu %.1f MB",
+      name.c_str(), stats.loadFactor, stats.maxLoadFactor,
+      stats.maxNumElementsAllowed, stats.numInfoIncreases, stats.numRehashes,
+      stats.numBytes / 1e6);
+  printf(" probe mean %.2f max %zu [", stats.meanProbeDistance(),
+      stats.maxProbeDistance());
+  for (auto distance = (size_t)0; distance <= stats.maxProbeDistance();
+       distance++) {
+    printf("%s%.1f%%", distance ? " " : "",
+        100.0 * stats.probeHistogram[distance] / stats.numElements);
+  }
+  printf("]\n");
+}
+
+// Inserts the keys into a robin_hood map and prints its statistics, to check
+// how well the hash distributes a key pattern.
+template <template <typename...> typename hash_map>
+void test_map_stats(const string& name, const vector<int>& keys) {
+  auto map = hash_map<int, float3>{};
+  for (auto key : keys) map[key] = {(float)key, 0, 0};
+  print_table_stats(name, map.stats());
+}
+
+// Builds a map of all keys with the given max load factor and growth factor,
+// and prints the peak memory of the build, which includes both the old and the
+// new table of the last rehash, next to the time of lookups of queries.
+template <template <typename...> typename hash_map>
+float3 test_map_load(const string& name, const vector<int>& keys,
+    const vector<int>& queries, float load, float growth) {
+  auto check = float3{0, 0, 0};
+  reset_peak_memory();
+  auto resident = get_resident_memory();
+  auto map      = hash_map<int, float3>{};
+  map.max_load_factor(load);
+  map.growth_factor(growth);
+  auto start = timer::get_time();
+  for (auto key : keys) map[key] = {(float)key, 0, 0};
+  auto build = timer::get_time() - start;
+  auto peak  = get_peak_memory() - resident;
+  auto& cmap = (const hash_map<int, float3>&)map;
+  start      = timer::get_time();
+  for (auto key : queries) check += cmap.find(key)->second;
+  auto lookup = timer::get_time() - start;
+  auto stats  = map.stats();
+  printf(
+      "%s load %.2f growth %.2f: peak %7.1f MB table %7.1f MB "
+      "build %6.1f ns/op lookup %6.2f ns/op at load %.2f\n",
+      name.c_str(), stats.maxLoadFactor, stats.growthFactor, peak,
+      stats.numBytes / 1e6, (double)build / keys.size(),
+      (double)lookup / queries.size(), stats.loadFactor);
+  return check;
+}
+
+// Checks that changing the max load factor of a table that already has storage
+// keeps its contents, and that tables with the same number of buckets but
+// different load factors can be copied into each other.
+template <template <typename...> typename hash_map>
+bool check_max_load_factor(const string& name) {
+  auto ok  = true;
+  auto sum = [](const hash_map<int, int>& map) {
+    auto sum = (int64_t)0;
+    for (auto& [key, value] : map) sum += value;
+    return sum;
+  };
+  auto map = hash_map<int, int>{};
+  for (auto key = 0; key < 10; key++) map[key] = key;
+  map.max_load_factor(0.95f);
+  for (auto key = 10; key < 200; key++) map[key] = key;
+  ok = ok && map.size() == 200 && sum(map) == 19900;
+  map.max_load_factor(0.3f);
+  ok = ok && map.size() == 200 && sum(map) == 19900;
+  for (auto key = 0; key < 200; key++) ok = ok && map.find(key)->second == key;
+  auto dense = hash_map<int, int>{}, sparse = hash_map<int, int>{};
+  dense.max_load_factor(0.95f);
+  sparse.max_load_factor(0.5f);
+  for (auto key = 0; key < 20; key++) {
+    dense[key]  = key;
+    sparse[key] = 2 * key;
+  }
+  sparse = dense;
+  ok     = ok && sparse.size() == 20 && sum(sparse) == 190;
+  auto copy = hash_map<int, int>{dense};
+  ok        = ok && copy.size() == 20 && sum(copy) == 190;
+  printf("%s max_load_factor change: %s\n", name.c_str(), ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Fills map, reserved for all keys, and prints the time of the inserts and of
+// the lookups of queries, with the hardware counters if enabled. Page sizes
+// show up in the dtlb-miss counts.
+template <typename Map>
+float3 test_map_alloc(const string& name, Map&& map, const vector<int>& keys,
+    const vector<int>& queries) {
+  auto check  = float3{0, 0, 0};
+  auto report = [&name](const string& phase, int64_t elapsed, size_t count,
+                    const perf_counters& counters) {
+    printf("%s %-6s %8.2f ns/op%s\n", name.c_str(), phase.c_str(),
+        (double)elapsed / count, counters.format().c_str());
+  };
+  {
+    auto counters = perf_counters{};
+    auto start    = timer::get_time();
+    map.reserve(keys.size());
+    for (auto key : keys) map[key] = {(float)key, 0, 0};
+    report("build", timer::get_time() - start, keys.size(), counters);
+  }
+  {
+    auto& cmap     = (const Map&)map;
+    auto  counters = perf_counters{};
+    auto  start    = timer::get_time();
+    for (auto key : queries) check += cmap.find(key)->second;
+    report("lookup", timer::get_time() - start, queries.size(), counters);
+  }
+  return check;
+}
+
+// Time to the first lookup of a flat map of size keys, when it is rebuilt from
+// its keys and values, as on a restart, versus when a snapshot saved with
+// writeSnapshot() is memory mapped and probed in place by mapped_flat_map,
+// followed by the lookup time of each. The snapshot was just written, so it is
+// likely in the page cache.
+float3 test_map_snapshot(int size, const string& filename) {
+  auto keys = vector<int>(size);
+  for (auto idx = 0; idx < size; idx++) {
+    keys[idx] = (int)((9187981ull * (size_t)idx) % (size_t)size);
+  }
+  auto rng     = std::mt19937_64{};
+  auto queries = vector<int>(1 << 22);
+  for (auto& key : queries) key = (int)(rng() % size);
+  auto check  = float3{0, 0, 0};
+  auto report = [](const string& name, const string& phase, int64_t elapsed) {
+    printf("%s %-12s in %10.3f ms\n", name.c_str(), phase.c_str(), elapsed / 1e6);
+  };
+  auto lookups = [&](const string& name, auto&& find) {
+    auto start = timer::get_time();
+    for (auto key : queries) check += find(key);
+    auto elapsed = timer::get_time() - start;
+    printf("%s %-12s    %10.2f ns/op\n", name.c_str(), "lookup",
+        (double)elapsed / queries.size());
+  };
+  {
+    auto start = timer::get_time();
+    auto map   = robin_hood::unordered_flat_map<int, float3>{};
+    for (auto key : keys) map[key] = {(float)key, 0, 0};
+    check += map.find(keys.back())->second;
+    report("robinflat_map  ", "rebuild", timer::get_time() - start);
+    lookups("robinflat_map  ", [&map](int key) { return map.find(key)->second; });
+
+    start        = timer::get_time();
+    auto buffer  = vector<uint64_t>((map.snapshotSize() + 7) / 8);
+    map.writeSnapshot(buffer.data());
+    auto fs = std::ofstream{filename, std::ios::binary};
+    fs.write((const char*)buffer.data(), map.snapshotSize());
+    fs.close();
+    report("robinflat_map  ", "save", timer::get_time() - start);
+  }
+  {
+    auto start  = timer::get_time();
+    auto file   = mapped_file{filename};
+    auto mapped = robin_hood::mapped_flat_map<int, float3>{file.data, file.size};
+    check += mapped.find(keys.back())->second;
+    report("mapped_flat_map", "map", timer::get_time() - start);
+    lookups("mapped_flat_map",
+        [&mapped](int key) { return mapped.find(key)->second; });
+  }
+  std::remove(filename.c_str());
+  return check;
+}
+
+// Timings of a map of a given size, in ns per operation, and a checksum.
+struct sweep_result {
+  string name        = "";
+  int    size        = 0;
+  double insert      = 0;
+  double lookup_hit  = 0;
+  double lookup_miss = 0;
+  double iterate     = 0;
+  double destroy     = 0;
+  float3 check       = {0, 0, 0};
+};
+
+// Builds a map with size entries and times insert, successful and failed
+// lookups, iteration and destruction. Small maps are built and looked up
+// multiple times, so that each measure covers enough operations.
+template <template <typename...> typename hash_map>
+sweep_result test_map_sweep(const string& name, int size) {
+  auto result = sweep_result{name, size};
+  auto keys   = vector<int>(size);
+  for (auto idx = 0; idx < size; idx++) {
+    keys[idx] = (int)((9187981ull * (size_t)idx) % (size_t)size);
+  }
+  auto build_repetitions  = std::max(1, 1000000 / size);
+  auto lookup_repetitions = std::max(1, 10000000 / size);
+  auto ops                = (double)size;
+  for (auto build = 0; build < build_repetitions; build++) {
+    auto start = timer::get_time();
+    auto map   = new hash_map<int, float3>();
+    for (auto key = 0; key < size; key++) (*map)[key] = {(float)key, 0, 0};
+    result.insert += (timer::get_time() - start) / ops / build_repetitions;
+    if (build == build_repetitions - 1) {
+      auto& cmap = (const hash_map<int, float3>&)*map;
+      start      = timer::get_time();
+      for (auto count = 0; count < lookup_repetitions; count++) {
+        for (auto key : keys) result.check += cmap.find(key)->second;
+      }
+      result.lookup_hit = (timer::get_time() - start) / ops /
+                          lookup_repetitions;
+      start = timer::get_time();
+      for (auto count = 0; count < lookup_repetitions; count++) {
+        for (auto key : keys) result.check[1] += cmap.count(key + size);
+      }
+      result.lookup_miss = (timer::get_time() - start) / ops /
+                           lookup_repetitions;
+      start = timer::get_time();
+      for (auto count = 0; count < lookup_repetitions; count++) {
+        for (auto& [_, value] : cmap) result.check += value;
+      }
+      result.iterate = (timer::get_time() - start) / ops / lookup_repetitions;
+    }
+    start = timer::get_time();
+    delete map;
+    result.destroy += (timer::get_time() - start) / ops / build_repetitions;
+  }
+  return result;
+}
+
+// Prints a sweep result as a CSV row or an element of a JSON array.
+void print_sweep(const sweep_result& result, const string& format, bool first) {
+  if (format == "json") {
+    printf("%s\n  {\"map\": \"%s\", \"size\": %d, \"insert\": %.3f, "
+           "\"lookup_hit\": %.3f, \"lookup_miss\": %.3f, \"iterate\": %.3f, "
+           "\"destroy\": %.3f, \"check\": %g}",
+        first ? "[" : ",", result.name.c_str(), result.size, result.insert,
+        result.lookup_hit, result.lookup_miss, result.iterate, result.destroy,
+        result.check[0] + result.check[1]);
+  } else {
+    if (first) {
+      printf("map,size,insert,lookup_hit,lookup_miss,iterate,destroy,check\n");
+    }
+    printf("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%g\n", result.name.c_str(),
+        result.size, result.insert, result.lookup_hit, result.lookup_miss,
+        result.iterate, result.destroy, result.check[0] + result.check[1]);
+  }
+  fflush(stdout);
+}
+
+// Returns the integer value following `--name` on the command line, or def.
+int get_option(int argc, const char** argv, const string& name, int def) {
+  for (auto i = 1; i + 1 < argc; i++) {
+    if (argv[i] == name) return atoi(argv[i + 1]);
+  }
+  return def;
+}
+
+// Returns the real value following `--name` on the command line, or def.
+double get_option(
+    int argc, const char** argv, const string& name, double def) {
+  for (auto i = 1; i + 1 < argc; i++) {
+    if (argv[i] == name) return atof(argv[i + 1]);
+  }
+  return def;
+}
+
+// Returns the string value following `--name` on the command line, or def.
+string get_option(
+    int argc, const char** argv, const string& name, const string& def) {
+  for (auto i = 1; i + 1 < argc; i++) {
+    if (argv[i] == name) return argv[i + 1];
+  }
+  return def;
+}
+
+// Returns the test to run, the first argument if not an option, or "values".
+string get_test(int argc, const char** argv) {
+  if (argc > 1 && argv[1][0] != '-') return argv[1];
+  return "values";
+}
+
 int main(int argc, const char** argv) {
+  perf_counters::parse_args(argc, argv);
+  auto test        = get_test(argc, argv);
+  auto num_threads = get_option(argc, argv, "--threads",
+      std::max((int)std::thread::hardware_concurrency(), 1));
+  auto write_percent = get_option(argc, argv, "--writes", 10);
+  auto max_size      = get_option(argc, argv, "--max-size", 50000000);
+  auto sweep_min     = get_option(argc, argv, "--sweep-min", 1000);
+  auto sweep_max     = get_option(argc, argv, "--sweep-max", 100000000);
+  auto steps         = std::max(get_option(argc, argv, "--steps", 2), 1);
+  auto alloc_size    = std::max(
+      get_option(argc, argv, "--alloc-size", 100000000), 1);
+  auto format        = get_option(argc, argv, "--format", "csv");
+  auto hit_percent   = get_option(argc, argv, "--hits", 40);
+  auto zipf          = get_option(argc, argv, "--zipf", 0.99);
+  auto reclaim       = get_option(argc, argv, "--reclaim", "sync");
   auto num_shapes = 10000, num_instances = 10000;
   auto positions = vector<float3>(num_shapes);
   for (auto shape = 0; shape < num_shapes; shape++) {
@@ -323,23 +1587,267 @@ int main(int argc, const char** argv) {
     shapes[instance] =
         (int)((9187981ull * (size_t)instance) % (size_t)num_shapes);
   }
-  test_raw_pointers("raw           pointers", positions, shapes);
-  test_vector_pointers("vector        pointers", positions, shapes);
-  test_vector_values("vector        values  ", positions, shapes);
-  test_map_pointers<unordered_map>("unordered_map pointers", positions, shapes);
-  test_map_values<unordered_map>("unordered_map values  ", positions, shapes);
-  test_map_pointers<unordered_flat_map>(
-      "robinflat_map pointers", positions, shapes);
-  test_map_values<unordered_flat_map>(
-      "robinflat_map values  ", positions, shapes);
-  test_map_pointers<unordered_node_map>(
-      "robinnode_map pointers", positions, shapes);
-  test_map_values<unordered_node_map>(
-      "robinnode_map values  ", positions, shapes);
+  // background|incremental, scenes are deleted synchronously otherwise
+  auto values_reclaimer = std::unique_ptr<reclaimer>{};
+  if (reclaim == "background" || reclaim == "incremental") {
+    values_reclaimer = std::make_unique<reclaimer>(
+        reclaim == "background" ? reclaimer::policy::background
+                                : reclaimer::policy::incremental);
+  }
+  scene_reclaimer = values_reclaimer.get();
+  if (test == "values" || test == "all") {
+    test_raw_pointers("raw           pointers", positions, shapes);
+    test_vector_pointers("vector        pointers", positions, shapes);
+    test_vector_values("vector        values  ", positions, shapes);
+    test_map_pointers<unordered_map>(
+        "unordered_map pointers", positions, shapes);
+    test_map_values<unordered_map>("unordered_map values  ", positions, shapes);
+    test_map_pointers<unordered_flat_map>(
+        "robinflat_map pointers", positions, shapes);
+    test_map_values<unordered_flat_map>(
+        "robinflat_map values  ", positions, shapes);
+    test_map_pointers<unordered_node_map>(
+        "robinnode_map pointers", positions, shapes);
+    test_map_values<unordered_node_map>(
+        "robinnode_map values  ", positions, shapes);
+    test_map_pointers<unordered_swiss_map>(
+        "swissflat_map pointers", positions, shapes);
+    test_map_values<unordered_swiss_map>(
+        "swissflat_map values  ", positions, shapes);
+    test_slotmap_values("slot_map      values  ", positions, shapes);
+    test_map_pointers<dense_int_map>(
+        "dense_int_map pointers", positions, shapes);
+    test_map_values<dense_int_map>("dense_int_map values  ", positions, shapes);
 #ifdef USE_ABSEIL
-  test_map_pointers<flat_hash_map>("absl_flat_map pointers", positions, shapes);
-  test_map_values<flat_hash_map>("absl_flat_map values  ", positions, shapes);
-  test_map_pointers<node_hash_map>("absl_node_map pointers", positions, shapes);
-  test_map_values<node_hash_map>("absl_node_map values  ", positions, shapes);
+    test_map_pointers<flat_hash_map>(
+        "absl_flat_map pointers", positions, shapes);
+    test_map_values<flat_hash_map>("absl_flat_map values  ", positions, shapes);
+    test_map_pointers<node_hash_map>(
+        "absl_node_map pointers", positions, shapes);
+    test_map_values<node_hash_map>("absl_node_map values  ", positions, shapes);
 #endif
-}
+  }
+  if (test == "concurrent" || test == "all") {
+    test_map_concurrent<unordered_map>(
+        "unordered_map concurrent", positions, shapes, num_threads);
+    test_map_concurrent<unordered_flat_map>(
+        "robinflat_map concurrent", positions, shapes, num_threads);
+    test_map_concurrent<unordered_node_map>(
+        "robinnode_map concurrent", positions, shapes, num_threads);
+    test_map_concurrent<unordered_swiss_map>(
+        "swissflat_map concurrent", positions, shapes, num_threads);
+#ifdef USE_ABSEIL
+    test_map_concurrent<flat_hash_map>(
+        "absl_flat_map concurrent", positions, shapes, num_threads);
+    test_map_concurrent<node_hash_map>(
+        "absl_node_map concurrent", positions, shapes, num_threads);
+#endif
+  }
+  if (test == "mixed" || test == "all") {
+    test_map_mixed<1>(
+        "locked_flat_map  mixed", positions, shapes, num_threads, write_percent);
+    test_map_mixed<64>(
+        "sharded_flat_map mixed", positions, shapes, num_threads, write_percent);
+  }
+  if (test == "batch" || test == "all") {
+    for (auto size : {10000, 1000000, 50000000}) {
+      if (size > max_size) continue;
+      test_map_batch<unordered_flat_map>("robinflat_map", size);
+      test_map_batch<unordered_node_map>("robinnode_map", size);
+    }
+  }
+  if (test == "erase" || test == "all") {
+    // distinct shape ids in scattered order, since the multiplier is coprime
+    // with num_shapes
+    auto erases = vector<int>(num_shapes / 2);
+    for (auto idx = 0; idx < (int)erases.size(); idx++) {
+      erases[idx] = (int)((9187981ull * (size_t)idx) % (size_t)num_shapes);
+    }
+    test_vector_erase("vector       ", positions, erases);
+    test_map_erase<unordered_map>("unordered_map", positions, erases);
+    test_map_erase<unordered_flat_map>("robinflat_map", positions, erases);
+    test_map_erase<unordered_node_map>("robinnode_map", positions, erases);
+    test_map_erase<unordered_swiss_map>("swissflat_map", positions, erases);
+#ifdef USE_ABSEIL
+    test_map_erase<flat_hash_map>("absl_flat_map", positions, erases);
+    test_map_erase<node_hash_map>("absl_node_map", positions, erases);
+#endif
+    test_slotmap_erase("slot_map     ", positions, erases);
+  }
+  if (test == "strings" || test == "all") {
+    auto short_names = vector<string>(num_shapes);
+    auto long_names  = vector<string>(num_shapes);
+    for (auto shape = 0; shape < num_shapes; shape++) {
+      short_names[shape] = "shape" + std::to_string(shape);
+      long_names[shape]  = "/assets/scenes/interior/living_room/meshes/shape" +
+                          std::to_string(shape) + ".ply";
+    }
+    for (auto& [length, names] :
+        {std::pair{"short", &short_names}, std::pair{"long ", &long_names}}) {
+      auto suffix = string{" "} + length;
+      test_map_strings<unordered_map>(
+          "unordered_map" + suffix, positions, *names, shapes);
+      test_map_strings<unordered_flat_map>(
+          "robinflat_map" + suffix, positions, *names, shapes);
+      test_map_strings<unordered_node_map>(
+          "robinnode_map" + suffix, positions, *names, shapes);
+      test_map_strings<unordered_swiss_map>(
+          "swissflat_map" + suffix, positions, *names, shapes);
+      test_map_strings<transparent_flat_map>(
+          "transflat_map" + suffix, positions, *names, shapes);
+      test_map_strings<transparent_node_map>(
+          "transnode_map" + suffix, positions, *names, shapes);
+#ifdef USE_ABSEIL
+      test_map_strings<flat_hash_map>(
+          "absl_flat_map" + suffix, positions, *names, shapes);
+      test_map_strings<node_hash_map>(
+          "absl_node_map" + suffix, positions, *names, shapes);
+#endif
+    }
+  }
+  if (test == "workloads" || test == "all") {
+    for (auto size : {10000, 1000000}) {
+      if (size > max_size) continue;
+      test_map_workloads<unordered_map>(
+          "unordered_map", size, hit_percent, zipf);
+      test_map_workloads<unordered_flat_map>(
+          "robinflat_map", size, hit_percent, zipf);
+      test_map_workloads<unordered_node_map>(
+          "robinnode_map", size, hit_percent, zipf);
+      test_map_workloads<unordered_swiss_map>(
+          "swissflat_map", size, hit_percent, zipf);
+#ifdef USE_ABSEIL
+      test_map_workloads<flat_hash_map>(
+          "absl_flat_map", size, hit_percent, zipf);
+      test_map_workloads<node_hash_map>(
+          "absl_node_map", size, hit_percent, zipf);
+#endif
+    }
+  }
+  if (test == "stats" || test == "all") {
+    auto size = std::min(1000000, max_size);
+    auto keys = [size](auto&& key) {
+      auto keys = vector<int>(size);
+      for (auto idx = 0; idx < size; idx++) keys[idx] = key((size_t)idx);
+      return keys;
+    };
+    auto sequential = keys([](size_t idx) { return (int)idx; });
+    auto scattered  = keys([size](size_t idx) {
+      return (int)((9187981ull * idx) % (size_t)size);
+    });
+    auto strided    = keys([](size_t idx) { return (int)(idx << 11); });
+    test_map_stats<unordered_flat_map>("robinflat_map sequential", sequential);
+    test_map_stats<unordered_flat_map>("robinflat_map scattered ", scattered);
+    test_map_stats<unordered_flat_map>("robinflat_map strided   ", strided);
+    test_map_stats<unordered_node_map>("robinnode_map sequential", sequential);
+    test_map_stats<unordered_node_map>("robinnode_map scattered ", scattered);
+    test_map_stats<unordered_node_map>("robinnode_map strided   ", strided);
+  }
+  if (test == "load" || test == "all") {
+    check_max_load_factor<unordered_flat_map>("robinflat_map");
+    check_max_load_factor<unordered_node_map>("robinnode_map");
+  }
+  if (test == "load") {
+    auto size = std::min(10000000, max_size);
+    auto keys = vector<int>(size);
+    for (auto idx = 0; idx < size; idx++) {
+      keys[idx] = (int)((9187981ull * (size_t)idx) % (size_t)size);
+    }
+    auto rng     = std::mt19937_64{};
+    auto queries = vector<int>(1 << 22);
+    for (auto& key : queries) key = (int)(rng() % size);
+    for (auto growth : {2.0f, 1.5f}) {
+      for (auto load : {0.5f, 0.7f, 0.8f, 0.9f}) {
+        test_map_load<unordered_flat_map>(
+            "robinflat_map", keys, queries, load, growth);
+        test_map_load<unordered_node_map>(
+            "robinnode_map", keys, queries, load, growth);
+      }
+    }
+  }
+  if (test == "snapshot" || test == "all") {
+    test_map_snapshot(std::min(10000000, max_size),
+        get_option(argc, argv, "--snapshot", "hashmap.snapshot"));
+  }
+  if (test == "alloc") {
+    auto size = alloc_size;
+    auto keys = vector<int>(size);
+    for (auto idx = 0; idx < size; idx++) {
+      keys[idx] = (int)((9187981ull * (size_t)idx) % (size_t)size);
+    }
+    auto rng     = std::mt19937_64{};
+    auto queries = vector<int>(1 << 24);
+    for (auto& key : queries) key = (int)(rng() % size);
+    auto huge_pages = huge_page_resource{};
+    {
+      test_map_alloc("robinflat_map malloc", unordered_flat_map<int, float3>{},
+          keys, queries);
+    }
+    {
+      // arena released at once at the end, as for a per-request arena
+      auto arena = std::pmr::monotonic_buffer_resource{};
+      test_map_alloc("robinflat_map arena ",
+          pmr_flat_map<int, float3>{pmr_allocator{&arena}}, keys, queries);
+    }
+    {
+      test_map_alloc("robinflat_map huge  ",
+          pmr_flat_map<int, float3>{pmr_allocator{&huge_pages}}, keys,
+          queries);
+    }
+    {
+      test_map_alloc("robinnode_map malloc", unordered_node_map<int, float3>{},
+          keys, queries);
+    }
+    {
+      auto arena = std::pmr::monotonic_buffer_resource{};
+      test_map_alloc("robinnode_map arena ",
+          pmr_node_map<int, float3>{pmr_allocator{&arena}}, keys, queries);
+    }
+    {
+      test_map_alloc("robinnode_map huge  ",
+          pmr_node_map<int, float3>{pmr_allocator{&huge_pages}}, keys,
+          queries);
+    }
+    {
+      test_map_alloc("swissflat_map malloc", unordered_swiss_map<int, float3>{},
+          keys, queries);
+    }
+    {
+      auto arena = std::pmr::monotonic_buffer_resource{};
+      test_map_alloc("swissflat_map arena ",
+          pmr_swiss_map<int, float3>{pmr_allocator{&arena}}, keys, queries);
+    }
+    {
+      test_map_alloc("swissflat_map huge  ",
+          pmr_swiss_map<int, float3>{pmr_allocator{&huge_pages}}, keys,
+          queries);
+    }
+    printf("huge pages: %.1f MB explicit, %.1f MB transparent\n",
+        huge_pages.hugetlb_bytes / 1e6, huge_pages.thp_bytes / 1e6);
+  }
+  if (test == "sweep") {
+    auto first = true;
+    for (auto step = 0;; step++) {
+      auto exact =
+          std::round(sweep_min * std::pow(10.0, (double)step / steps));
+      if (exact > sweep_max) break;
+      auto size = (int)exact;
+      print_sweep(test_map_sweep<unordered_map>("unordered_map", size), format,
+          first);
+      first = false;
+      print_sweep(test_map_sweep<unordered_flat_map>("robinflat_map", size),
+          format, first);
+      print_sweep(test_map_sweep<unordered_node_map>("robinnode_map", size),
+          format, first);
+      print_sweep(test_map_sweep<unordered_swiss_map>("swissflat_map", size),
+          format, first);
+#ifdef USE_ABSEIL
+      print_sweep(test_map_sweep<flat_hash_map>("absl_flat_map", size), format,
+          first);
+      print_sweep(test_map_sweep<node_hash_map>("absl_node_map", size), format,
+          first);
+#endif
+    }
+    if (format == "json") printf("%s]\n", first ? "[" : "\n");
+  }
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#pragma once
+
+// Hardware performance counters for the benchmark timers, read with
+// perf_event_open on Linux. Counting is requested with `--perf` on the command
+// line of each benchmark. If the counters cannot be opened, e.g. on other
+// platforms, in VMs without a PMU or with a restrictive perf_event_paranoid,
+// they are reported as unavailable and the timers print wall time only.
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct perf_counters {
+  // Whether timers should count events. Set from the command line.
+  inline static bool enabled = false;
+
+  static const int num_events = 6;
+  inline static const char* names[num_events] = {
+      "cycles", "instrs", "l1d-miss", "llc-miss", "dtlb-miss", "br-miss"};
+
+  perf_counters() {
+    if (!enabled) return;
+#ifdef __linux__
+    auto hw_cache = [](uint64_t cache) -> uint64_t {
+      return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    const std::array<std::pair<uint32_t, uint64_t>, num_events> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, hw_cache(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, hw_cache(PERF_COUNT_HW_CACHE_DTLB)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+    // events are opened separately, not as a group, so that a missing event
+    // does not disable the others and the kernel can multiplex them
+    for (auto event = 0; event < num_events; event++) {
+      auto attr           = perf_event_attr{};
+      attr.size           = sizeof(attr);
+      attr.type           = events[event].first;
+      attr.config         = events[event].second;
+      attr.disabled       = 1;
+      attr.inherit        = 1;  // count threads spawned by the benchmark
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds[event] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    if (!available()) {
+      if (!warned) fprintf(stderr, "perf counters unavailable\n");
+      warned = true;
+      return;
+    }
+    for (auto fd : fds) {
+      if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    }
+    for (auto fd : fds) {
+      if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  ~perf_counters() {
+#ifdef __linux__
+    for (auto fd : fds) {
+      if (fd >= 0) close(fd);
+    }
+#endif
+  }
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  // Whether at least one counter could be opened.
+  bool available() const {
+    for (auto fd : fds) {
+      if (fd >= 0) return true;
+    }
+    return false;
+  }
+
+  // Counts since construction, scaled when the kernel multiplexed the
+  // counters. Unavailable events are -1.
+  std::array<int64_t, num_events> read() const {
+    auto counts = std::array<int64_t, num_events>{};
+    for (auto event = 0; event < num_events; event++) {
+      counts[event] = -1;
+#ifdef __linux__
+      uint64_t values[3] = {0, 0, 0};  // value, time enabled, time running
+      if (fds[event] < 0 ||
+          ::read(fds[event], values, sizeof(values)) != sizeof(values))
+        continue;
+      counts[event] = values[2] ? (int64_t)((double)values[0] * values[1] /
+                                            values[2])
+                                : 0;
+#endif
+    }
+    return counts;
+  }
+
+  // Counts formatted as `name value` pairs, plus instructions per cycle.
+  // Returns an empty string if counting is disabled or unavailable.
+  std::string format() const {
+    if (!available()) return "";
+    auto counts = read();
+    auto result = std::string{};
+    char buffer[64];
+    for (auto event = 0; event < num_events; event++) {
+      if (counts[event] < 0) continue;
+      snprintf(buffer, sizeof(buffer), " %s %lld", names[event],
+          (long long)counts[event]);
+      result += buffer;
+    }
+    if (counts[0] > 0 && counts[1] >= 0) {
+      snprintf(buffer, sizeof(buffer), " ipc %.2f",
+          (double)counts[1] / (double)counts[0]);
+      result += buffer;
+    }
+    return result;
+  }
+
+  // Enables counting if `--perf` is among the command line arguments.
+  static void parse_args(int argc, const char** argv) {
+    for (auto i = 1; i < argc; i++) {
+      if (std::string{argv[i]} == "--perf") enabled = true;
+    }
+  }
+
+ private:
+  std::array<int, num_events> fds = {-1, -1, -1, -1, -1, -1};
+  inline static bool          warned = false;
+};
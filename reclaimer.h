@@ -0,0 +1,156 @@
+#pragma once
+
+// Deferred destruction: retired objects are destroyed later instead of by the
+// caller, so that freeing a large scene does not pause it. With the background
+// policy, a reclaimer thread destroys them as soon as they are retired. With
+// the incremental policy, each call to tick() destroys at most per_tick of
+// them on the calling thread, e.g. once per frame. Destructors may retire more
+// objects, which are queued after the others. The reclaimer waits for all
+// retired objects to be destroyed when it is destroyed.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct reclaimer {
+  enum struct policy { background, incremental };
+
+  explicit reclaimer(
+      policy reclaim_policy = policy::background, size_t per_tick = 64)
+      : mode{reclaim_policy}, per_tick{std::max(per_tick, (size_t)1)} {
+    if (mode == policy::background) worker = std::thread{[this]() { run(); }};
+  }
+  ~reclaimer() {
+    wait();
+    if (!worker.joinable()) return;
+    {
+      auto lock = std::lock_guard{mutex};
+      stop      = true;
+    }
+    retired.notify_one();
+    worker.join();
+  }
+  reclaimer(const reclaimer&) = delete;
+  reclaimer& operator=(const reclaimer&) = delete;
+
+  // Takes ownership of object, that is deleted later.
+  template <typename T>
+  void retire(std::unique_ptr<T> object) {
+    if (!object) return;
+    push({object.release(), [](void* ptr) { delete (T*)ptr; }});
+  }
+  // Moves value to the heap, where it is destroyed later. Moving is cheap for
+  // containers and smart pointers, unlike freeing what they own.
+  template <typename T>
+  void retire_value(T&& value) {
+    retire(std::make_unique<std::decay_t<T>>(std::forward<T>(value)));
+  }
+
+  // Destroys at most per_tick retired objects on the calling thread. Returns
+  // whether objects are left. Does nothing with the background policy.
+  bool tick() {
+    if (mode == policy::background) return pending() != 0;
+    auto batch = std::vector<item>{};
+    {
+      auto lock = std::lock_guard{mutex};
+      auto count = std::min(per_tick, queue.size());
+      batch.assign(queue.begin(), queue.begin() + count);
+      queue.erase(queue.begin(), queue.begin() + count);
+      destroying += count;
+    }
+    auto elapsed = destroy(batch);
+    auto lock    = std::lock_guard{mutex};
+    destroying -= batch.size();
+    max_tick = std::max(max_tick, elapsed);
+    return !queue.empty();
+  }
+  // Blocks until all retired objects are destroyed, ticking with the
+  // incremental policy.
+  void wait() {
+    if (mode == policy::incremental) {
+      while (tick()) continue;
+      return;
+    }
+    auto lock = std::unique_lock{mutex};
+    reclaimed.wait(
+        lock, [this]() { return queue.empty() && destroying == 0; });
+  }
+
+  // Objects retired and not yet destroyed.
+  size_t pending() const {
+    auto lock = std::lock_guard{mutex};
+    return queue.size() + destroying;
+  }
+  // Time spent destroying objects, and the longest tick, in ns.
+  int64_t reclaim_time() const {
+    auto lock = std::lock_guard{mutex};
+    return total_time;
+  }
+  int64_t max_tick_time() const {
+    auto lock = std::lock_guard{mutex};
+    return max_tick;
+  }
+
+ private:
+  struct item {
+    void* object = nullptr;
+    void (*destroy)(void*) = nullptr;
+  };
+
+  void push(item retired_item) {
+    {
+      auto lock = std::lock_guard{mutex};
+      queue.push_back(retired_item);
+    }
+    if (mode == policy::background) retired.notify_one();
+  }
+  // Destroys the objects without holding the lock, so that their destructors
+  // can retire more objects. Returns the elapsed time.
+  int64_t destroy(const std::vector<item>& batch) {
+    if (batch.empty()) return 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& retired_item : batch) retired_item.destroy(retired_item.object);
+    auto duration = std::chrono::steady_clock::now() - start;
+    auto elapsed  = (int64_t)std::chrono::duration_cast<
+        std::chrono::nanoseconds>(duration).count();
+    auto lock = std::lock_guard{mutex};
+    total_time += elapsed;
+    return elapsed;
+  }
+  // Background thread, that destroys all queued objects at once.
+  void run() {
+    auto lock = std::unique_lock{mutex};
+    while (true) {
+      retired.wait(lock, [this]() { return stop || !queue.empty(); });
+      if (queue.empty()) return;
+      auto batch = std::vector<item>(queue.begin(), queue.end());
+      queue.clear();
+      destroying = batch.size();
+      lock.unlock();
+      destroy(batch);
+      lock.lock();
+      destroying = 0;
+      if (queue.empty()) reclaimed.notify_all();
+    }
+  }
+
+  policy                  mode       = policy::background;
+  size_t                  per_tick   = 64;
+  mutable std::mutex      mutex      = {};
+  std::condition_variable retired    = {};  // signals the worker
+  std::condition_variable reclaimed  = {};  // signals wait()
+  std::deque<item>        queue      = {};
+  size_t                  destroying = 0;  // objects taken from the queue
+  bool                    stop       = false;
+  int64_t                 total_time = 0;
+  int64_t                 max_tick   = 0;
+  std::thread             worker     = {};
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+// Slot map: values are stored densely in a vector and addressed by
+// generational handles. Insertion and erasure are O(1) and do not invalidate
+// the handles of other values. Erasure moves the last value into the hole,
+// so the order of the values is not stable. Handles to erased values are
+// detected by the generation stored in their slot, which is incremented
+// whenever the slot is freed.
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+template <typename T>
+struct slot_map {
+  static constexpr uint32_t invalid_index = 0xffffffff;
+
+  struct handle {
+    uint32_t index      = invalid_index;
+    uint32_t generation = 0;
+
+    bool operator==(const handle& other) const {
+      return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const handle& other) const { return !(*this == other); }
+  };
+
+  using iterator       = typename std::vector<T>::iterator;
+  using const_iterator = typename std::vector<T>::const_iterator;
+
+  // Constructs a value in place and returns its handle.
+  template <typename... Args>
+  handle emplace(Args&&... args) {
+    auto slot = free_head;
+    if (slot != invalid_index) {
+      free_head = slots[slot].index;
+    } else {
+      slot = (uint32_t)slots.size();
+      slots.push_back({});
+    }
+    values.emplace_back(std::forward<Args>(args)...);
+    value_slots.push_back(slot);
+    slots[slot].index = (uint32_t)(values.size() - 1);
+    return {slot, slots[slot].generation};
+  }
+  handle insert(const T& value) { return emplace(value); }
+  handle insert(T&& value) { return emplace(std::move(value)); }
+
+  // Erases the value of a handle. Returns whether the handle was valid.
+  bool erase(handle item) {
+    if (!contains(item)) return false;
+    auto index = slots[item.index].index;
+    if (index != values.size() - 1) {
+      values[index]                   = std::move(values.back());
+      value_slots[index]              = value_slots.back();
+      slots[value_slots[index]].index = index;
+    }
+    values.pop_back();
+    value_slots.pop_back();
+    free_slot(item.index);
+    return true;
+  }
+
+  // Whether the handle refers to a value that has not been erased.
+  bool contains(handle item) const {
+    return item.index < slots.size() &&
+           slots[item.index].generation == item.generation;
+  }
+  // Pointer to the value of a handle, or nullptr if the handle is stale.
+  T* find(handle item) {
+    return contains(item) ? &values[slots[item.index].index] : nullptr;
+  }
+  const T* find(handle item) const {
+    return contains(item) ? &values[slots[item.index].index] : nullptr;
+  }
+  // Value of a handle, that must be valid.
+  T&       operator[](handle item) { return values[slots[item.index].index]; }
+  const T& operator[](handle item) const {
+    return values[slots[item.index].index];
+  }
+
+  // Handle of the value at position index in the dense storage.
+  handle handle_at(size_t index) const {
+    auto slot = value_slots[index];
+    return {slot, slots[slot].generation};
+  }
+
+  size_t size() const { return values.size(); }
+  bool   empty() const { return values.empty(); }
+  void   reserve(size_t size) {
+    values.reserve(size);
+    value_slots.reserve(size);
+    slots.reserve(size);
+  }
+  // Erases all values, invalidating all handles.
+  void clear() {
+    for (auto slot : value_slots) free_slot(slot);
+    values.clear();
+    value_slots.clear();
+  }
+
+  // Iteration over the dense values, in storage order.
+  iterator       begin() { return values.begin(); }
+  iterator       end() { return values.end(); }
+  const_iterator begin() const { return values.begin(); }
+  const_iterator end() const { return values.end(); }
+
+ private:
+  // For live slots, index is the position of the value. For free slots, it
+  // is the next free slot.
+  struct slot_info {
+    uint32_t index      = invalid_index;
+    uint32_t generation = 0;
+  };
+
+  void free_slot(uint32_t slot) {
+    slots[slot].generation++;
+    slots[slot].index = free_head;
+    free_head         = slot;
+  }
+
+  std::vector<T>         values      = {};
+  std::vector<uint32_t>  value_slots = {};  // slot of each value
+  std::vector<slot_info> slots       = {};
+  uint32_t               free_head   = invalid_index;
+};
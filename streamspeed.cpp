@@ -1,11 +1,31 @@
+#include <array>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <chrono>
 #include <sstream>
 #include <string_view>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define STREAMSPEED_SIMD 1
+#endif
+
+#include "perfcounters.h"
 
 using namespace std;
 
@@ -25,18 +45,23 @@ struct timer {
     sprintf(buffer, "%02d:%02d:%02d.%03d", hours, mins, secs, msecs);
     return buffer;
   }
+  string countersf() { return counters.format(); }
   static int64_t get_time() {
     return std::chrono::high_resolution_clock::now().time_since_epoch().count();
   }
 
  private:
-  int64_t start = 0;
+  perf_counters counters = {};  // opened before the clock starts
+  int64_t       start    = 0;
 };
 
 const auto values_per_line = 8;
-const auto num_lines = 131072;
-const auto num_values = values_per_line * num_lines;
+const auto bytes_per_line = 157; // average length of a text line
+auto num_lines = 131072; // about 20 MB of text, set with --mb
+auto num_values = values_per_line * num_lines;
 const auto repetitions = 10;
+auto max_threads = (int)std::thread::hardware_concurrency(); // set with --threads
+auto engine = "all"s; // number parsing engine for parse_mmap, set with --engine
 
 auto int_data = vector<int>(num_values);
 auto flt_data = vector<float>(num_values);
@@ -46,6 +71,8 @@ auto flt_check = vector<float>(num_values);
 void gen_data() {
     int_data.resize(num_values);
     flt_data.resize(num_values);
+    int_check.resize(num_values);
+    flt_check.resize(num_values);
     for(auto& v : int_data) v = rand();
     for(auto& v : flt_data) v = rand() / (float)RAND_MAX;
 }
@@ -59,7 +86,7 @@ void print_data() {
     }
     fflush(fs);
     fclose(fs);
-    cout << "print_data: " << timer.elapsedf() << "\n";
+    cout << "print_data: " << timer.elapsedf() << timer.countersf() << "\n";
 }
 void write_data() {
     auto timer = ::timer{};
@@ -70,8 +97,62 @@ void write_data() {
     }
     fflush(fs);
     fclose(fs);
-    cout << "write_data: " << timer.elapsedf() << "\n";
+    cout << "write_data: " << timer.elapsedf() << timer.countersf() << "\n";
+}
+
+// Header of the structure-of-arrays binary files, followed by count ints and
+// then count floats. The endianness field reads 0x04030201 on a machine with
+// the opposite byte order to the writer.
+struct bulk_header {
+    char magic[4] = {'S', 'O', 'A', '1'};
+    uint32_t endianness = 0x01020304;
+    uint64_t count = 0;
+};
+void write_bulk() {
+    auto timer = ::timer{};
+    auto fs = fopen("test/data_soa.bin", "wb");
+    auto header = bulk_header{};
+    header.count = num_values;
+    fwrite(&header, sizeof(header), 1, fs);
+    fwrite(int_data.data(), sizeof(int), num_values, fs);
+    fwrite(flt_data.data(), sizeof(float), num_values, fs);
+    fflush(fs);
+    fclose(fs);
+    cout << "write_bulk: " << timer.elapsedf() << timer.countersf() << "\n";
+}
+#ifndef _WIN32
+// Calls readv or writev until all iovecs are transferred, since a single call
+// may transfer less, e.g. over 2 GB on Linux. Returns false on error or EOF.
+template<typename Transfer>
+bool transfer_all(Transfer&& transfer, int fd, iovec* iov, int count) {
+    while(count > 0) {
+        auto size = transfer(fd, iov, count);
+        if(size <= 0) return false;
+        while(count > 0 && (size_t)size >= iov->iov_len) {
+            size -= iov->iov_len;
+            iov ++;
+            count --;
+        }
+        if(count > 0) {
+            iov->iov_base = (char*)iov->iov_base + size;
+            iov->iov_len -= size;
+        }
+    }
+    return true;
+}
+void write_bulk_writev() {
+    auto timer = ::timer{};
+    auto fd = open("test/data_soa.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    auto header = bulk_header{};
+    header.count = num_values;
+    iovec iov[3] = {{&header, sizeof(header)},
+        {int_data.data(), num_values * sizeof(int)},
+        {flt_data.data(), num_values * sizeof(float)}};
+    transfer_all(writev, fd, iov, 3);
+    close(fd);
+    cout << "write_bulk_writev: " << timer.elapsedf() << timer.countersf() << "\n";
 }
+#endif
 
 void print_file_directly() {
     auto timer = ::timer{};
@@ -82,7 +163,7 @@ void print_file_directly() {
     }
     fflush(fs);
     fclose(fs);
-    cout << "print_file_directly: " << timer.elapsedf() << "\n";
+    cout << "print_file_directly: " << timer.elapsedf() << timer.countersf() << "\n";
 }
 void print_stream_directly() {
     auto timer = ::timer{};
@@ -94,7 +175,72 @@ void print_stream_directly() {
     }
     fs.flush();
     fs.close();
-    cout << "print_stream_directly: " << timer.elapsedf() << "\n";
+    cout << "print_stream_directly: " << timer.elapsedf() << timer.countersf() << "\n";
+}
+
+// Writes value at str in decimal and returns the pointer past it. The number
+// of digits is computed from the bit length, then digits are written two at
+// a time from a table, from the last to the first.
+inline char* format_int(char* str, int value) {
+    static const char digit_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    static const uint32_t powers_of_10[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+        10000000, 100000000, 1000000000};
+    auto number = (uint32_t)value;
+    if(value < 0) {
+        *str++ = '-';
+        number = 0u - number;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    auto bits = 32 - __builtin_clz(number | 1);
+    auto guess = (bits * 1233) >> 12; // bits * log10(2)
+    auto length = guess + 1 - ((number | 1) < powers_of_10[guess]);
+#else
+    auto length = 1;
+    while(length < 10 && number >= powers_of_10[length]) length ++;
+#endif
+    auto end = str + length;
+    auto ptr = end;
+    while(number >= 100) {
+        ptr -= 2;
+        memcpy(ptr, digit_pairs + (number % 100) * 2, 2);
+        number /= 100;
+    }
+    if(number >= 10) {
+        memcpy(ptr - 2, digit_pairs + number * 2, 2);
+    } else {
+        ptr[-1] = (char)('0' + number);
+    }
+    return end;
+}
+
+// Formats into a large reusable buffer, that is written with a single fwrite
+// when full. Floats use to_chars, that prints the shortest representation
+// that parses back to the same value, instead of the 6 digits of %g.
+// Lines have exactly values_per_line values, as parse_file_fast expects.
+void print_fast() {
+    auto timer = ::timer{};
+    static auto buffer = vector<char>(16 * 1048576);
+    auto fs = fopen("test/print_fast.txt", "wb");
+    auto ptr = buffer.data();
+    auto end = buffer.data() + buffer.size();
+    for(auto i = 0; i < num_values; i ++) {
+        // longest int and float, with separators, are less than 64 chars
+        if(end - ptr < 64) {
+            fwrite(buffer.data(), 1, ptr - buffer.data(), fs);
+            ptr = buffer.data();
+        }
+        ptr = format_int(ptr, int_data[i]);
+        *ptr++ = ' ';
+        ptr = to_chars(ptr, end, flt_data[i]).ptr;
+        *ptr++ = ' ';
+        if((i + 1) % values_per_line == 0) *ptr++ = '\n';
+    }
+    fwrite(buffer.data(), 1, ptr - buffer.data(), fs);
+    fclose(fs);
+    cout << "print_fast: " << timer.elapsedf() << timer.countersf() << "\n";
 }
 
 void parse_file_directly() {
@@ -104,7 +250,7 @@ void parse_file_directly() {
         fscanf(fs, "%d %g ", &(int_check[i]), &(flt_check[i]));
     }
     fclose(fs);
-    cout << "parse_file_directly: " << timer.elapsedf() << "\n";
+    cout << "parse_file_directly: " << timer.elapsedf() << timer.countersf() << "\n";
 }
 void parse_stream_directly() {
     auto timer = ::timer{};
@@ -113,7 +259,7 @@ void parse_stream_directly() {
         fs >> int_check[i] >> flt_check[i];
     }
     fs.close();
-    cout << "parse_stream_directly: " << timer.elapsedf() << "\n";    
+    cout << "parse_stream_directly: " << timer.elapsedf() << timer.countersf() << "\n";    
 }
 
 void parse_file_lines() {
@@ -131,7 +277,7 @@ void parse_file_lines() {
         }
     }
     fclose(fs);
-    cout << "parse_file_lines: " << timer.elapsedf() << "\n";
+    cout << "parse_file_lines: " << timer.elapsedf() << timer.countersf() << "\n";
 }
 void parse_stream_lines() {
     auto timer = ::timer{};
@@ -147,12 +293,12 @@ void parse_stream_lines() {
         }
     }
     fs.close();
-    cout << "parse_stream_lines: " << timer.elapsedf() << "\n";    
+    cout << "parse_stream_lines: " << timer.elapsedf() << timer.countersf() << "\n";    
 }
 
-void parse_file_fast() {
-    auto timer = ::timer{};
-    auto fs = fopen("test/data.txt", "rt");
+// Parses filename into int_check and flt_check with strtol and strtof.
+void parse_file_values(const char* filename) {
+    auto fs = fopen(filename, "rt");
     char line[4096];
     for(auto j = 0; j < num_lines; j ++) {
         fgets(line, sizeof(line), fs);
@@ -167,7 +313,18 @@ void parse_file_fast() {
         }
     }
     fclose(fs);
-    cout << "parse_file_fast: " << timer.elapsedf() << "\n";
+}
+void parse_file_fast() {
+    auto timer = ::timer{};
+    parse_file_values("test/data.txt");
+    cout << "parse_file_fast: " << timer.elapsedf() << timer.countersf() << "\n";
+}
+// Checks that the output of print_fast parses back to the exact same values.
+void check_print_fast() {
+    parse_file_values("test/print_fast.txt");
+    auto same = memcmp(int_check.data(), int_data.data(), num_values * sizeof(int)) == 0 &&
+        memcmp(flt_check.data(), flt_data.data(), num_values * sizeof(float)) == 0;
+    cout << "print_fast roundtrip: " << (same ? "ok" : "failed") << "\n";
 }
 void parse_stream_fast() {
     // auto buffer = vector<char>(1048576);
@@ -188,7 +345,7 @@ void parse_stream_fast() {
         }
     }
     fs.close();
-    cout << "parse_stream_fast: " << timer.elapsedf() << "\n";    
+    cout << "parse_stream_fast: " << timer.elapsedf() << timer.countersf() << "\n";    
 }
 inline string_view& operator>>(string_view& str, int& value) {
     auto offset = (char*)nullptr;
@@ -215,9 +372,186 @@ void parse_stream_fast1() {
         }
     }
     fs.close();
-    cout << "parse_stream_fast1: " << timer.elapsedf() << "\n";    
+    cout << "parse_stream_fast1: " << timer.elapsedf() << timer.countersf() << "\n";    
+}
+
+#ifndef _WIN32
+// Parses the mapped file in place, without copying lines to a buffer.
+// strtol/strtof need a terminator after the last number, which is always
+// there since print_data ends each value with a space.
+void parse_mmap_fast() {
+    auto timer = ::timer{};
+    auto fd = open("test/data.txt", O_RDONLY);
+    auto size = (size_t)lseek(fd, 0, SEEK_END);
+    auto data = (char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    madvise(data, size, MADV_SEQUENTIAL);
+    auto scanner = string_view{data, size};
+    for(auto i = 0; i < num_values; i ++) {
+        scanner >> int_check[i] >> flt_check[i];
+    }
+    munmap(data, size);
+    close(fd);
+    cout << "parse_mmap_fast: " << timer.elapsedf() << timer.countersf() << "\n";
 }
 
+// Parses the mapped file in parallel. The file is split into newline-aligned
+// chunks, that worker threads take in turn and parse into per-chunk arrays.
+// The chunk outputs are then copied to their place, found with a prefix sum
+// over the number of values in each chunk.
+void parse_parallel(int num_threads) {
+    auto timer = ::timer{};
+    auto fd = open("test/data.txt", O_RDONLY);
+    auto size = (size_t)lseek(fd, 0, SEEK_END);
+    auto data = (char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    // split in more chunks than threads to balance the work
+    auto num_chunks = num_threads * 8;
+    auto chunks = vector<string_view>{};
+    auto chunk_begin = (size_t)0;
+    for(auto c = 1; c <= num_chunks && chunk_begin < size; c ++) {
+        auto chunk_end = c == num_chunks ? size : size * c / num_chunks;
+        while(chunk_end < size && data[chunk_end - 1] != '\n') chunk_end ++;
+        if(chunk_end <= chunk_begin) continue;
+        chunks.push_back({data + chunk_begin, chunk_end - chunk_begin});
+        chunk_begin = chunk_end;
+    }
+
+    // parse chunks
+    auto chunk_ints = vector<vector<int>>(chunks.size());
+    auto chunk_flts = vector<vector<float>>(chunks.size());
+    auto next_chunk = atomic<size_t>{0};
+    auto parse_chunks = [&]() {
+        for(auto c = next_chunk++; c < chunks.size(); c = next_chunk++) {
+            auto scanner = chunks[c];
+            auto& ints = chunk_ints[c];
+            auto& flts = chunk_flts[c];
+            ints.reserve(scanner.size() / (bytes_per_line / values_per_line) + 1);
+            flts.reserve(scanner.size() / (bytes_per_line / values_per_line) + 1);
+            while(true) {
+                while(!scanner.empty() && isspace(scanner.front())) scanner.remove_prefix(1);
+                if(scanner.empty()) break;
+                scanner >> ints.emplace_back() >> flts.emplace_back();
+            }
+        }
+    };
+    auto threads = vector<thread>{};
+    for(auto t = 0; t < num_threads; t ++) threads.emplace_back(parse_chunks);
+    for(auto& thread : threads) thread.join();
+    threads.clear();
+
+    // stitch outputs
+    auto offsets = vector<size_t>(chunks.size() + 1, 0);
+    for(auto c = (size_t)0; c < chunks.size(); c ++) {
+        offsets[c + 1] = offsets[c] + chunk_ints[c].size();
+    }
+    next_chunk = 0;
+    auto copy_chunks = [&]() {
+        for(auto c = next_chunk++; c < chunks.size(); c = next_chunk++) {
+            auto count = std::min(chunk_ints[c].size(),
+                (size_t)num_values - std::min(offsets[c], (size_t)num_values));
+            std::copy(chunk_ints[c].begin(), chunk_ints[c].begin() + count,
+                int_check.begin() + offsets[c]);
+            std::copy(chunk_flts[c].begin(), chunk_flts[c].begin() + count,
+                flt_check.begin() + offsets[c]);
+        }
+    };
+    for(auto t = 0; t < num_threads; t ++) threads.emplace_back(copy_chunks);
+    for(auto& thread : threads) thread.join();
+
+    munmap(data, size);
+    close(fd);
+    cout << "parse_parallel_" << num_threads << ": " << timer.elapsedf() << timer.countersf() << "\n";
+}
+// Number parsers used by parse_mmap. They skip leading whitespace, parse one
+// number starting at str and return the pointer past it. Unlike strtol/strtof
+// they ignore the locale.
+inline const char* skip_space(const char* str, const char* end) {
+    while(str < end && (*str == ' ' || *str == '\n')) str ++;
+    return str;
+}
+inline const char* parse_from_chars(const char* str, const char* end, int& value) {
+    str = skip_space(str, end);
+    return from_chars(str, end, value).ptr;
+}
+inline const char* parse_from_chars(const char* str, const char* end, float& value) {
+    str = skip_space(str, end);
+    return from_chars(str, end, value).ptr;
+}
+
+#ifdef STREAMSPEED_SIMD
+// Parses a run of up to 10 digits with SSE4.1: the digits are found with one
+// compare, right-aligned with a shuffle, and combined with multiply-adds
+// into groups of 2, 4 and 8 digits. Falls back to from_chars near the end of
+// the buffer, where 16 bytes cannot be loaded, for longer runs, and for values
+// out of the int range, so that both engines handle them the same way.
+__attribute__((target("sse4.1")))
+inline const char* parse_simd(const char* str, const char* end, int& value) {
+    // shuffles that move the first n bytes to the end of the register
+    alignas(16) static const auto shuffles = [] {
+        auto shuffles = array<array<int8_t, 16>, 17>{};
+        for(auto n = 0; n <= 16; n ++) {
+            for(auto i = 0; i < 16; i ++) shuffles[n][i] = i >= 16 - n ? i - (16 - n) : -1;
+        }
+        return shuffles;
+    }();
+    str = skip_space(str, end);
+    auto negative = str < end && *str == '-';
+    if(end - str < 17) return parse_from_chars(str, end, value);
+    auto chars = _mm_loadu_si128((const __m128i*)(str + negative));
+    auto digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    auto is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+    auto length = __builtin_ctz(~_mm_movemask_epi8(is_digit) | 0x10000);
+    if(length == 0 || length > 10) return parse_from_chars(str, end, value);
+    digits = _mm_shuffle_epi8(digits, _mm_load_si128((const __m128i*)shuffles[length].data()));
+    auto pairs = _mm_maddubs_epi16(digits, _mm_set1_epi16(0x010a)); // 10, 1
+    auto quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010064)); // 100, 1
+    auto octs = _mm_madd_epi16(_mm_packus_epi32(quads, quads), _mm_set1_epi32(0x00012710)); // 10000, 1
+    auto number = (int64_t)(uint32_t)_mm_extract_epi32(octs, 0) * 100000000 +
+        (uint32_t)_mm_extract_epi32(octs, 1);
+    auto max_number = (int64_t)numeric_limits<int>::max() + negative;
+    if(number > max_number) return parse_from_chars(str, end, value);
+    value = (int)(negative ? -number : number);
+    return str + negative + length;
+}
+#endif
+
+// Same as parse_mmap_fast, but with the number parsers of the given engine.
+// Prints the throughput too, to compare engines.
+template<typename Engine>
+void parse_mmap(const string& name, Engine&& parse_int) {
+    auto timer = ::timer{};
+    auto fd = open("test/data.txt", O_RDONLY);
+    auto size = (size_t)lseek(fd, 0, SEEK_END);
+    auto data = (char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    madvise(data, size, MADV_SEQUENTIAL);
+    auto scanner = (const char*)data;
+    auto end = scanner + size;
+    for(auto i = 0; i < num_values; i ++) {
+        scanner = parse_int(scanner, end, int_check[i]);
+        scanner = parse_from_chars(scanner, end, flt_check[i]);
+    }
+    munmap(data, size);
+    close(fd);
+    auto seconds = timer.elapsed() / 1e9;
+    cout << "parse_mmap_" << name << ": " << timer.elapsedf() << " " << size / seconds / 1e9
+         << " GB/s" << timer.countersf() << "\n";
+}
+void parse_mmap_from_chars() {
+    parse_mmap("from_chars", [](const char* str, const char* end, int& value) {
+        return parse_from_chars(str, end, value);
+    });
+}
+#ifdef STREAMSPEED_SIMD
+void parse_mmap_simd() {
+    if(!__builtin_cpu_supports("sse4.1")) return;
+    parse_mmap("simd", [](const char* str, const char* end, int& value) {
+        return parse_simd(str, end, value);
+    });
+}
+#endif
+#endif
+
 void read_file_directly() {
     auto timer = ::timer{};
     auto fs = fopen("test/data.bin", "rb");
@@ -226,7 +560,7 @@ void read_file_directly() {
         fread(&(flt_check[i]), sizeof(float), 1, fs);
     }
     fclose(fs);
-    cout << "read_file_directly: " << timer.elapsedf() << "\n";
+    cout << "read_file_directly: " << timer.elapsedf() << timer.countersf() << "\n";
 }
 void read_stream_directly() {
     auto timer = ::timer{};
@@ -236,16 +570,73 @@ void read_stream_directly() {
         fs.read((char*)&(flt_check[i]), sizeof(float));
     }
     fs.close();
-    cout << "read_stream_directly: " << timer.elapsedf() << "\n";    
+    cout << "read_stream_directly: " << timer.elapsedf() << timer.countersf() << "\n";    
 }
 
+// Checks the header written by write_bulk. Prints an error if not valid.
+bool check_bulk_header(const bulk_header& header) {
+    auto valid = bulk_header{};
+    if(memcmp(header.magic, valid.magic, sizeof(valid.magic)) != 0) {
+        cout << "bulk file: bad magic\n";
+    } else if(header.endianness != valid.endianness) {
+        cout << "bulk file: wrong endianness\n";
+    } else if(header.count != (uint64_t)num_values) {
+        cout << "bulk file: wrong count\n";
+    } else {
+        return true;
+    }
+    return false;
+}
+void read_bulk() {
+    auto timer = ::timer{};
+    auto fs = fopen("test/data_soa.bin", "rb");
+    auto header = bulk_header{};
+    if(fread(&header, sizeof(header), 1, fs) == 1 && check_bulk_header(header)) {
+        fread(int_check.data(), sizeof(int), num_values, fs);
+        fread(flt_check.data(), sizeof(float), num_values, fs);
+    }
+    fclose(fs);
+    cout << "read_bulk: " << timer.elapsedf() << timer.countersf() << "\n";
+}
+#ifndef _WIN32
+// Reads the header and both arrays with one readv, then checks the header.
+void read_bulk_readv() {
+    auto timer = ::timer{};
+    auto fd = open("test/data_soa.bin", O_RDONLY);
+    auto header = bulk_header{};
+    iovec iov[3] = {{&header, sizeof(header)},
+        {int_check.data(), num_values * sizeof(int)},
+        {flt_check.data(), num_values * sizeof(float)}};
+    if(!transfer_all(readv, fd, iov, 3)) cout << "bulk file: too short\n";
+    check_bulk_header(header);
+    close(fd);
+    cout << "read_bulk_readv: " << timer.elapsedf() << timer.countersf() << "\n";
+}
+#endif
+
 int main(int argc, const char** argv) {
     std::ios_base::sync_with_stdio(false);
+    perf_counters::parse_args(argc, argv);
+    for(auto i = 1; i + 1 < argc; i ++) {
+        if(string{argv[i]} == "--mb") {
+            num_lines = (int)(atof(argv[i + 1]) * 1048576 / bytes_per_line);
+            num_values = values_per_line * num_lines;
+        }
+        if(string{argv[i]} == "--threads") max_threads = atoi(argv[i + 1]);
+        if(string{argv[i]} == "--engine") engine = argv[i + 1];
+    }
+    max_threads = std::max(max_threads, 1);
     gen_data();
     print_data();
     write_data();
+    write_bulk();
+#ifndef _WIN32
+    write_bulk_writev();
+#endif
     print_file_directly();
     print_stream_directly();
+    print_fast();
+    check_print_fast();
     for(auto i = 0; i < repetitions; i ++) parse_file_directly();
     for(auto i = 0; i < repetitions; i ++) parse_stream_directly();
     for(auto i = 0; i < repetitions; i ++) parse_file_lines();
@@ -253,6 +644,25 @@ int main(int argc, const char** argv) {
     for(auto i = 0; i < repetitions; i ++) parse_file_fast();
     for(auto i = 0; i < repetitions; i ++) parse_stream_fast();
     for(auto i = 0; i < repetitions; i ++) parse_stream_fast1();
+#ifndef _WIN32
+    for(auto i = 0; i < repetitions; i ++) parse_mmap_fast();
+    if(engine == "from_chars" || engine == "all") {
+        for(auto i = 0; i < repetitions; i ++) parse_mmap_from_chars();
+    }
+#ifdef STREAMSPEED_SIMD
+    if(engine == "simd" || engine == "all") {
+        for(auto i = 0; i < repetitions; i ++) parse_mmap_simd();
+    }
+#endif
+    for(auto num_threads = 1; num_threads < max_threads * 2; num_threads *= 2) {
+        num_threads = std::min(num_threads, max_threads);
+        for(auto i = 0; i < repetitions; i ++) parse_parallel(num_threads);
+    }
+#endif
     for(auto i = 0; i < repetitions; i ++) read_file_directly();
     for(auto i = 0; i < repetitions; i ++) read_stream_directly();
+    for(auto i = 0; i < repetitions; i ++) read_bulk();
+#ifndef _WIN32
+    for(auto i = 0; i < repetitions; i ++) read_bulk_readv();
+#endif
 }
\ No newline at end of file
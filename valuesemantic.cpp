@@ -4,10 +4,24 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define VALUESEMANTIC_SIMD 1
+#endif
+
+#include "perfcounters.h"
+#include "reclaimer.h"
+#include "slotmap.h"
+
 using namespace std;
 
 using float2   = array<float, 2>;
@@ -30,25 +44,83 @@ struct timer {
     sprintf(buffer, "%02d:%02d:%02d", hours, mins, secs);
     return buffer;
   }
+  string countersf() { return counters.format(); }
   static int64_t get_time() {
     return std::chrono::high_resolution_clock::now().time_since_epoch().count();
   }
 
  private:
-  int64_t start = 0;
+  perf_counters counters = {};  // opened before the clock starts
+  int64_t       start    = 0;
+};
+
+// Memory used by the process in MB. Fields that are not available on the
+// platform are zero.
+struct memory_usage {
+  size_t resident = 0;  // resident set size
+  size_t peak     = 0;  // peak resident set size
+  size_t vsize    = 0;  // virtual memory size
+  size_t pss      = 0;  // proportional set size, i.e. shared pages split
+  size_t heap     = 0;  // bytes allocated with malloc and still in use
 };
 
+#if defined(__APPLE__)
 #include <mach/mach.h>
-pair<size_t, size_t> get_used_memory() {
-  struct task_basic_info t_info;
-  mach_msg_type_number_t t_info_count = TASK_BASIC_INFO_COUNT;
+memory_usage get_used_memory() {
+  struct mach_task_basic_info t_info;
+  mach_msg_type_number_t      t_info_count = MACH_TASK_BASIC_INFO_COUNT;
 
-  if (KERN_SUCCESS != task_info(mach_task_self(), TASK_BASIC_INFO,
+  if (KERN_SUCCESS != task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
                           (task_info_t)&t_info, &t_info_count))
-    return {0, 0};
-  return {((size_t)t_info.resident_size) / (1024 * 1024),
-      ((size_t)t_info.virtual_size) / (1024 * 1024)};
+    return {};
+  auto usage     = memory_usage{};
+  usage.resident = ((size_t)t_info.resident_size) / (1024 * 1024);
+  usage.peak     = ((size_t)t_info.resident_size_max) / (1024 * 1024);
+  usage.vsize    = ((size_t)t_info.virtual_size) / (1024 * 1024);
+  return usage;
+}
+// The peak resident size cannot be reset on macOS.
+void reset_peak_memory() {}
+#elif defined(__linux__)
+#include <malloc.h>
+// Reads `name: value kB` lines from a /proc file into values, in MB.
+void read_proc_fields(const char* filename,
+    const vector<pair<string_view, size_t*>>& fields) {
+  auto fs = fopen(filename, "rt");
+  if (!fs) return;
+  char line[256];
+  while (fgets(line, sizeof(line), fs)) {
+    for (auto& [name, value] : fields) {
+      if (strncmp(line, name.data(), name.size()) != 0) continue;
+      *value = strtoull(line + name.size(), nullptr, 10) / 1024;
+    }
+  }
+  fclose(fs);
 }
+memory_usage get_used_memory() {
+  auto usage = memory_usage{};
+  read_proc_fields("/proc/self/status", {{"VmRSS:", &usage.resident},
+                                            {"VmHWM:", &usage.peak},
+                                            {"VmSize:", &usage.vsize}});
+  read_proc_fields("/proc/self/smaps_rollup", {{"Pss:", &usage.pss}});
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  auto info  = mallinfo2();
+  usage.heap = (info.uordblks + info.hblkhd) / (1024 * 1024);
+#endif
+  return usage;
+}
+// Resets VmHWM to the current resident size, so that each test measures its
+// own peak. Needs Linux 4.0 or later, otherwise the peak is the process one.
+void reset_peak_memory() {
+  auto fs = fopen("/proc/self/clear_refs", "wt");
+  if (!fs) return;
+  fputs("5", fs);
+  fclose(fs);
+}
+#else
+memory_usage get_used_memory() { return {}; }
+void         reset_peak_memory() {}
+#endif
 
 struct value_model {
   struct shape {
@@ -74,9 +146,9 @@ struct unique_model {
     vector<int3>   triangles = {};
   };
   struct instance {
-    string   name  = "";
-    float3x4 frame = {};
-    shape*   shape = nullptr;
+    string               name  = "";
+    float3x4             frame = {};
+    unique_model::shape* shape = nullptr;
   };
   vector<unique_ptr<shape>>    shapes    = {};
   vector<unique_ptr<instance>> instances = {};
@@ -90,9 +162,9 @@ struct shared_model {
     vector<int3>   triangles = {};
   };
   struct instance {
-    string            name  = "";
-    float3x4          frame = {};
-    shared_ptr<shape> shape = nullptr;
+    string                          name  = "";
+    float3x4                        frame = {};
+    shared_ptr<shared_model::shape> shape = nullptr;
   };
   vector<shared_ptr<shape>>    shapes    = {};
   vector<shared_ptr<instance>> instances = {};
@@ -106,9 +178,9 @@ struct raw_model {
     vector<int3>   triangles = {};
   };
   struct instance {
-    string   name  = "";
-    float3x4 frame = {};
-    shape*   shape = nullptr;
+    string            name  = "";
+    float3x4          frame = {};
+    raw_model::shape* shape = nullptr;
   };
   vector<shape*>    shapes    = {};
   vector<instance*> instances = {};
@@ -119,79 +191,324 @@ struct raw_model {
   }
 };
 
+// Shapes store ranges into scene-wide buffers, so that the vertices of all
+// shapes are contiguous. Erased shapes leave their data in the buffers.
+struct packed_model {
+  struct range {
+    size_t start = 0;
+    size_t count = 0;
+  };
+  struct shape {
+    string name      = "";
+    range  positions = {};
+    range  normals   = {};
+    range  triangles = {};
+  };
+  struct instance {
+    string   name  = "";
+    float3x4 frame = {};
+    int      shape = -1;
+  };
+  vector<shape>    shapes    = {};
+  vector<instance> instances = {};
+  vector<float3>   positions = {};
+  vector<float3>   normals   = {};
+  vector<int3>     triangles = {};
+};
+
+// Shapes and instances are stored in slot maps and instances refer to shapes
+// by handle, so that erasing a shape is O(1) and keeps the other handles valid.
+struct slotmap_model {
+  struct shape {
+    string         name      = "";
+    vector<float3> positions = {};
+    vector<float3> normals   = {};
+    vector<int3>   triangles = {};
+  };
+  struct instance {
+    string                                 name  = "";
+    float3x4                               frame = {};
+    slot_map<slotmap_model::shape>::handle shape = {};
+  };
+  slot_map<shape>    shapes    = {};
+  slot_map<instance> instances = {};
+};
+
+// All shapes, instances and vertex arrays are allocated from one monotonic
+// arena. The scene data is placed in the arena too and is never destroyed,
+// since the pmr containers only return memory to the arena, which does
+// nothing. Clearing the scene is then a single arena release.
+struct arena_model {
+  struct shape {
+    pmr::string         name      = {};
+    pmr::vector<float3> positions = {};
+    pmr::vector<float3> normals   = {};
+    pmr::vector<int3>   triangles = {};
+
+    explicit shape(pmr::memory_resource* arena)
+        : name{arena}, positions{arena}, normals{arena}, triangles{arena} {}
+  };
+  struct instance {
+    pmr::string name  = {};
+    float3x4    frame = {};
+    int         shape = -1;
+
+    explicit instance(pmr::memory_resource* arena) : name{arena} {}
+  };
+  struct data {
+    pmr::vector<shape>    shapes    = {};
+    pmr::vector<instance> instances = {};
+
+    explicit data(pmr::memory_resource* arena)
+        : shapes{arena}, instances{arena} {}
+  };
+  unique_ptr<pmr::monotonic_buffer_resource> arena =
+      make_unique<pmr::monotonic_buffer_resource>();
+  data* scene = nullptr;
+};
+
+// Copies of the scene share their shapes, and shapes share their vertex
+// buffers, so that copying a scene only copies pointers and instances. Shapes
+// and buffers are copied on write when they are shared, so that editing one
+// copy leaves the others unchanged. Sharing is detected with use_count, so a
+// scene and its copies must not be edited or copied concurrently.
+struct cow_model {
+  template <typename T>
+  using buffer = shared_ptr<vector<T>>;
+  struct shape {
+    string         name      = "";
+    buffer<float3> positions = nullptr;
+    buffer<float3> normals   = nullptr;
+    buffer<int3>   triangles = nullptr;
+  };
+  struct instance {
+    string   name  = "";
+    float3x4 frame = {};
+    int      shape = -1;
+  };
+  vector<shared_ptr<shape>> shapes    = {};
+  vector<instance>          instances = {};
+};
+
+// Calls func(block, first, last) on num_threads threads, each with a
+// contiguous block of [0, count). Runs on the calling thread for one thread.
+template <typename Func>
+void parallel_blocks(int count, int num_threads, Func&& func) {
+  if (num_threads <= 1) return func(0, 0, count);
+  auto threads = vector<std::thread>{};
+  for (auto block = 0; block < num_threads; block++) {
+    threads.emplace_back([&, block]() {
+      auto first = (int)((int64_t)count * block / num_threads);
+      auto last  = (int)((int64_t)count * (block + 1) / num_threads);
+      func(block, first, last);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+// Calls func(idx) for each idx in [0, count) on num_threads threads.
+template <typename Func>
+void parallel_for(int count, int num_threads, Func&& func) {
+  parallel_blocks(count, num_threads, [&](int, int first, int last) {
+    for (auto idx = first; idx < last; idx++) func(idx);
+  });
+}
+
+// Sums func(idx) for each idx in [0, count) on num_threads threads. Partial
+// sums are added in block order, so the result does not depend on timing.
+template <typename Func>
+double parallel_sum(int count, int num_threads, Func&& func) {
+  auto sums = vector<double>(max(num_threads, 1), 0);
+  parallel_blocks(count, num_threads, [&](int block, int first, int last) {
+    auto sum = (double)0;
+    for (auto idx = first; idx < last; idx++) sum += func(idx);
+    sums[block] = sum;
+  });
+  auto sum = (double)0;
+  for (auto block_sum : sums) sum += block_sum;
+  return sum;
+}
+
+// Scenes are built with shapes and instances created on num_threads threads,
+// so that allocations and reference counting run concurrently.
 void init_scene(value_model& scene, int vertices, int triangles, int shapes,
-    int instances) {
-  for (auto i = 0; i < shapes; i++) {
-    auto& shape = scene.shapes.emplace_back();
+    int instances, int threads) {
+  scene.shapes.resize(shapes);
+  parallel_for(shapes, threads, [&](int idx) {
+    auto& shape = scene.shapes[idx];
     shape.positions.resize(vertices);
     shape.normals.resize(vertices);
     shape.triangles.resize(triangles);
     for (auto& pos : shape.positions) pos = {1, 2, 3};
-  }
-  for (auto i = 0; i < instances; i++) {
-    auto& instance = scene.instances.emplace_back();
-    instance.shape = i % (int)scene.shapes.size();
-  }
+  });
+  scene.instances.resize(instances);
+  parallel_for(instances, threads, [&](int idx) {
+    auto& instance = scene.instances[idx];
+    instance.shape = idx % (int)scene.shapes.size();
+  });
 }
 
 void init_scene(unique_ptr<unique_model>& scene, int vertices, int triangles,
-    int shapes, int instances) {
+    int shapes, int instances, int threads) {
   scene = make_unique<unique_model>();
-  for (auto i = 0; i < shapes; i++) {
+  scene->shapes.resize(shapes);
+  parallel_for(shapes, threads, [&](int idx) {
     auto shape = make_unique<unique_model::shape>();
     shape->positions.resize(vertices);
     shape->normals.resize(vertices);
     shape->triangles.resize(triangles);
     for (auto& pos : shape->positions) pos = {1, 2, 3};
-    scene->shapes.push_back(std::move(shape));
-  }
-  for (auto i = 0; i < instances; i++) {
+    scene->shapes[idx] = std::move(shape);
+  });
+  scene->instances.resize(instances);
+  parallel_for(instances, threads, [&](int idx) {
     auto instance   = make_unique<unique_model::instance>();
-    instance->shape = scene->shapes[i % (int)scene->shapes.size()].get();
-    scene->instances.push_back(std::move(instance));
-  }
+    instance->shape = scene->shapes[idx % (int)scene->shapes.size()].get();
+    scene->instances[idx] = std::move(instance);
+  });
 }
 
 void init_scene(shared_ptr<shared_model>& scene, int vertices, int triangles,
-    int shapes, int instances) {
+    int shapes, int instances, int threads) {
   scene = make_shared<shared_model>();
-  for (auto i = 0; i < shapes; i++) {
+  scene->shapes.resize(shapes);
+  parallel_for(shapes, threads, [&](int idx) {
     auto shape = make_shared<shared_model::shape>();
     shape->positions.resize(vertices);
     shape->normals.resize(vertices);
     shape->triangles.resize(triangles);
     for (auto& pos : shape->positions) pos = {1, 2, 3};
-    scene->shapes.push_back(shape);
-  }
-  for (auto i = 0; i < instances; i++) {
+    scene->shapes[idx] = shape;
+  });
+  scene->instances.resize(instances);
+  parallel_for(instances, threads, [&](int idx) {
     auto instance   = make_shared<shared_model::instance>();
-    instance->shape = scene->shapes[i % (int)scene->shapes.size()];
-    scene->instances.push_back(instance);
-  }
+    instance->shape = scene->shapes[idx % (int)scene->shapes.size()];
+    scene->instances[idx] = instance;
+  });
 }
 
-void init_scene(
-    raw_model*& scene, int vertices, int triangles, int shapes, int instances) {
+void init_scene(raw_model*& scene, int vertices, int triangles, int shapes,
+    int instances, int threads) {
   scene = new raw_model{};
-  for (auto i = 0; i < shapes; i++) {
+  scene->shapes.resize(shapes);
+  parallel_for(shapes, threads, [&](int idx) {
     auto shape = new raw_model::shape{};
     shape->positions.resize(vertices);
     shape->normals.resize(vertices);
     shape->triangles.resize(triangles);
     for (auto& pos : shape->positions) pos = {1, 2, 3};
-    scene->shapes.push_back(shape);
+    scene->shapes[idx] = shape;
+  });
+  scene->instances.resize(instances);
+  parallel_for(instances, threads, [&](int idx) {
+    auto instance   = new raw_model::instance();
+    instance->shape = scene->shapes[idx % (int)scene->shapes.size()];
+    scene->instances[idx] = instance;
+  });
+}
+
+// Slot maps are not thread-safe, so shapes and instances are inserted on the
+// calling thread and only shapes are filled in parallel.
+void init_scene(slotmap_model& scene, int vertices, int triangles, int shapes,
+    int instances, int threads) {
+  scene.shapes.reserve(shapes);
+  for (auto i = 0; i < shapes; i++) scene.shapes.emplace();
+  parallel_for(shapes, threads, [&](int idx) {
+    auto& shape = scene.shapes.begin()[idx];
+    shape.positions.resize(vertices);
+    shape.normals.resize(vertices);
+    shape.triangles.resize(triangles);
+    for (auto& pos : shape.positions) pos = {1, 2, 3};
+  });
+  scene.instances.reserve(instances);
+  for (auto i = 0; i < instances; i++) {
+    auto  handle   = scene.instances.emplace();
+    auto& instance = scene.instances[handle];
+    instance.shape = scene.shapes.handle_at(i % (int)scene.shapes.size());
+  }
+}
+
+// The buffers are allocated and zeroed on the calling thread, only the
+// positions are filled in parallel.
+void init_scene(packed_model& scene, int vertices, int triangles, int shapes,
+    int instances, int threads) {
+  scene.shapes.resize(shapes);
+  scene.positions.resize((size_t)vertices * shapes);
+  scene.normals.resize((size_t)vertices * shapes);
+  scene.triangles.resize((size_t)triangles * shapes);
+  parallel_for(shapes, threads, [&](int idx) {
+    auto& shape     = scene.shapes[idx];
+    shape.positions = {(size_t)vertices * idx, (size_t)vertices};
+    shape.normals   = {(size_t)vertices * idx, (size_t)vertices};
+    shape.triangles = {(size_t)triangles * idx, (size_t)triangles};
+    auto positions  = scene.positions.data() + shape.positions.start;
+    for (auto vid = 0; vid < vertices; vid++) positions[vid] = {1, 2, 3};
+  });
+  scene.instances.resize(instances);
+  parallel_for(instances, threads, [&](int idx) {
+    auto& instance = scene.instances[idx];
+    instance.shape = idx % (int)scene.shapes.size();
+  });
+}
+
+// The arena is not thread-safe, so vertex arrays are reserved on the calling
+// thread and only resized and filled in parallel.
+void init_scene(arena_model& scene, int vertices, int triangles, int shapes,
+    int instances, int threads) {
+  // size the arena for the whole scene, so that it is a single upstream
+  // allocation instead of geometrically growing chunks
+  auto shape_size = sizeof(arena_model::shape) + sizeof(float3) * vertices * 2 +
+                    sizeof(int3) * triangles + 64;
+  auto size = sizeof(arena_model::data) + shape_size * shapes +
+              sizeof(arena_model::instance) * instances + 64;
+  scene.arena = make_unique<pmr::monotonic_buffer_resource>(size);
+  auto arena  = scene.arena.get();
+  scene.scene = new (arena->allocate(sizeof(arena_model::data),
+      alignof(arena_model::data))) arena_model::data{arena};
+  scene.scene->shapes.reserve(shapes);
+  scene.scene->instances.reserve(instances);
+  for (auto i = 0; i < shapes; i++) {
+    auto& shape = scene.scene->shapes.emplace_back(arena);
+    shape.positions.reserve(vertices);
+    shape.normals.reserve(vertices);
+    shape.triangles.reserve(triangles);
   }
+  parallel_for(shapes, threads, [&](int idx) {
+    auto& shape = scene.scene->shapes[idx];
+    shape.positions.resize(vertices);
+    shape.normals.resize(vertices);
+    shape.triangles.resize(triangles);
+    for (auto& pos : shape.positions) pos = {1, 2, 3};
+  });
   for (auto i = 0; i < instances; i++) {
-    auto instance   = new raw_model::instance();
-    instance->shape = scene->shapes[i % (int)scene->shapes.size()];
-    scene->instances.push_back(instance);
+    auto& instance = scene.scene->instances.emplace_back(arena);
+    instance.shape = i % (int)scene.scene->shapes.size();
   }
 }
 
+void init_scene(cow_model& scene, int vertices, int triangles, int shapes,
+    int instances, int threads) {
+  scene.shapes.resize(shapes);
+  parallel_for(shapes, threads, [&](int idx) {
+    auto shape       = make_shared<cow_model::shape>();
+    shape->positions = make_shared<vector<float3>>(vertices, float3{1, 2, 3});
+    shape->normals   = make_shared<vector<float3>>(vertices);
+    shape->triangles = make_shared<vector<int3>>(triangles);
+    scene.shapes[idx] = std::move(shape);
+  });
+  scene.instances.resize(instances);
+  parallel_for(instances, threads, [&](int idx) {
+    auto& instance = scene.instances[idx];
+    instance.shape = idx % (int)scene.shapes.size();
+  });
+}
+
 template<typename any_model>
-any_model make_scene(int vertices, int triangles, int shapes, int instances) {
+any_model make_scene(
+    int vertices, int triangles, int shapes, int instances, int threads) {
   auto scene = any_model{};
-  init_scene(scene, vertices, triangles, shapes, instances);
+  init_scene(scene, vertices, triangles, shapes, instances, threads);
   return scene;
 }
 
@@ -202,23 +519,153 @@ void clear_scene(raw_model* scene) {
   delete scene;
   scene = {};
 }
+void clear_scene(packed_model& scene) { scene = {}; }
+void clear_scene(slotmap_model& scene) { scene = {}; }
+void clear_scene(arena_model& scene) {
+  scene.scene = nullptr;
+  scene.arena->release();
+}
+void clear_scene(cow_model& scene) { scene = {}; }
 
-double sum_vertices(value_model& scene) {
-  auto sum = (double)0;
-  for (auto& instance : scene.instances) {
-    auto& shape = scene.shapes[instance.shape];
+// Deferred clears move the scene data to a reclaimer, that frees it later.
+// Shapes and instances are retired one by one where they are separate
+// objects, so that an incremental reclaimer destroys a few per tick. The
+// caller only pays for moving them, and for freeing the emptied containers.
+void clear_scene(value_model& scene, reclaimer& reclaimer) {
+  for (auto& shape : scene.shapes) reclaimer.retire_value(std::move(shape));
+  reclaimer.retire_value(std::move(scene.instances));
+  scene = {};
+}
+void clear_scene(unique_ptr<unique_model>& scene, reclaimer& reclaimer) {
+  for (auto& shape : scene->shapes) reclaimer.retire(std::move(shape));
+  for (auto& instance : scene->instances) reclaimer.retire(std::move(instance));
+  scene = {};
+}
+void clear_scene(shared_ptr<shared_model>& scene, reclaimer& reclaimer) {
+  for (auto& shape : scene->shapes) reclaimer.retire_value(std::move(shape));
+  for (auto& instance : scene->instances)
+    reclaimer.retire_value(std::move(instance));
+  scene = {};
+}
+void clear_scene(raw_model* scene, reclaimer& reclaimer) {
+  for (auto shape : scene->shapes)
+    reclaimer.retire(unique_ptr<raw_model::shape>{shape});
+  for (auto instance : scene->instances)
+    reclaimer.retire(unique_ptr<raw_model::instance>{instance});
+  scene->shapes.clear();
+  scene->instances.clear();
+  delete scene;
+}
+// The buffers are shared by all shapes, so they are retired whole.
+void clear_scene(packed_model& scene, reclaimer& reclaimer) {
+  reclaimer.retire_value(std::move(scene.positions));
+  reclaimer.retire_value(std::move(scene.normals));
+  reclaimer.retire_value(std::move(scene.triangles));
+  reclaimer.retire_value(std::move(scene.shapes));
+  reclaimer.retire_value(std::move(scene.instances));
+  scene = {};
+}
+void clear_scene(slotmap_model& scene, reclaimer& reclaimer) {
+  for (auto& shape : scene.shapes) reclaimer.retire_value(std::move(shape));
+  reclaimer.retire_value(std::move(scene.instances));
+  scene = {};
+}
+// Releasing the arena is already a single operation, that is deferred whole.
+void clear_scene(arena_model& scene, reclaimer& reclaimer) {
+  scene.scene = nullptr;
+  reclaimer.retire(std::move(scene.arena));
+  scene.arena = make_unique<pmr::monotonic_buffer_resource>();
+}
+void clear_scene(cow_model& scene, reclaimer& reclaimer) {
+  for (auto& shape : scene.shapes) reclaimer.retire_value(std::move(shape));
+  reclaimer.retire_value(std::move(scene.instances));
+  scene = {};
+}
+
+// Vertices are summed with instances split across threads.
+double sum_vertices(value_model& scene, int threads) {
+  return parallel_sum((int)scene.instances.size(), threads, [&](int idx) {
+    auto& shape = scene.shapes[scene.instances[idx].shape];
+    auto  sum   = (double)0;
     for (auto& pos : shape.positions) sum += pos[0] + pos[1] + pos[2];
+    return sum;
+  });
+}
+// Sums a float stream, accumulating in double like the scalar loops.
+double sum_floats(const float* values, size_t count) {
+  auto sum = (double)0;
+  for (auto idx = (size_t)0; idx < count; idx += 3)
+    sum += values[idx + 0] + values[idx + 1] + values[idx + 2];
+  return sum;
+}
+#ifdef VALUESEMANTIC_SIMD
+// Sums 16 floats per iteration, converted to doubles in four accumulators.
+__attribute__((target("avx2"))) double sum_floats_avx2(
+    const float* values, size_t count) {
+  auto sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+  auto sum2 = _mm256_setzero_pd(), sum3 = _mm256_setzero_pd();
+  auto idx  = (size_t)0;
+  for (; idx + 16 <= count; idx += 16) {
+    auto data = values + idx;
+    sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm_loadu_ps(data + 0)));
+    sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm_loadu_ps(data + 4)));
+    sum2 = _mm256_add_pd(sum2, _mm256_cvtps_pd(_mm_loadu_ps(data + 8)));
+    sum3 = _mm256_add_pd(sum3, _mm256_cvtps_pd(_mm_loadu_ps(data + 12)));
   }
+  auto sum4 = _mm256_add_pd(
+      _mm256_add_pd(sum0, sum1), _mm256_add_pd(sum2, sum3));
+  auto sum2x = _mm_add_pd(
+      _mm256_castpd256_pd128(sum4), _mm256_extractf128_pd(sum4, 1));
+  auto sum = _mm_cvtsd_f64(_mm_add_sd(sum2x, _mm_unpackhi_pd(sum2x, sum2x)));
+  for (; idx < count; idx++) sum += values[idx];
   return sum;
 }
+#endif
+
+double sum_vertices(packed_model& scene, int threads) {
+  auto sum_range = &sum_floats;
+#ifdef VALUESEMANTIC_SIMD
+  if (__builtin_cpu_supports("avx2")) sum_range = &sum_floats_avx2;
+#endif
+  return parallel_sum((int)scene.instances.size(), threads, [&](int idx) {
+    auto& range = scene.shapes[scene.instances[idx].shape].positions;
+    return sum_range(scene.positions[range.start].data(), range.count * 3);
+  });
+}
+double sum_vertices(slotmap_model& scene, int threads) {
+  auto instances = scene.instances.begin();
+  return parallel_sum((int)scene.instances.size(), threads, [&](int idx) {
+    auto& shape = scene.shapes[instances[idx].shape];
+    auto  sum   = (double)0;
+    for (auto& pos : shape.positions) sum += pos[0] + pos[1] + pos[2];
+    return sum;
+  });
+}
+double sum_vertices(arena_model& scene, int threads) {
+  auto& instances = scene.scene->instances;
+  return parallel_sum((int)instances.size(), threads, [&](int idx) {
+    auto& shape = scene.scene->shapes[instances[idx].shape];
+    auto  sum   = (double)0;
+    for (auto& pos : shape.positions) sum += pos[0] + pos[1] + pos[2];
+    return sum;
+  });
+}
+double sum_vertices(cow_model& scene, int threads) {
+  return parallel_sum((int)scene.instances.size(), threads, [&](int idx) {
+    auto& shape = scene.shapes[scene.instances[idx].shape];
+    auto  sum   = (double)0;
+    for (auto& pos : *shape->positions) sum += pos[0] + pos[1] + pos[2];
+    return sum;
+  });
+}
 template <typename ptr_model>
-double sum_vertices(const ptr_model& scene) {
-  auto sum = (double)0;
-  for (auto& instance : scene->instances) {
-    auto& shape = instance->shape;
+double sum_vertices(const ptr_model& scene, int threads) {
+  return parallel_sum((int)scene->instances.size(), threads, [&](int idx) {
+    auto& shape = scene->instances[idx]->shape;
+    auto  sum   = (double)0;
     for (auto& pos : shape->positions) sum += pos[0] + pos[1] + pos[2];
-  }
-  return sum;
+    return sum;
+  });
 }
 
 void erase_shapes(value_model& scene, int erases) {
@@ -226,6 +673,21 @@ void erase_shapes(value_model& scene, int erases) {
     scene.shapes.erase(scene.shapes.begin() + 10);
   }
 }
+void erase_shapes(packed_model& scene, int erases) {
+  for (auto i = 0; i < erases; i++) {
+    scene.shapes.erase(scene.shapes.begin() + 10);
+  }
+}
+void erase_shapes(slotmap_model& scene, int erases) {
+  for (auto i = 0; i < erases; i++) {
+    scene.shapes.erase(scene.shapes.handle_at(10));
+  }
+}
+void erase_shapes(arena_model& scene, int erases) {
+  for (auto i = 0; i < erases; i++) {
+    scene.scene->shapes.erase(scene.scene->shapes.begin() + 10);
+  }
+}
 template <typename ptr_model>
 void erase_shapes(ptr_model& scene, int erases) {
   for (auto i = 0; i < erases; i++) {
@@ -238,43 +700,378 @@ void erase_shapes(raw_model* scene, int erases) {
     scene->shapes.erase(scene->shapes.begin() + 10);
   }
 }
+void erase_shapes(cow_model& scene, int erases) {
+  for (auto i = 0; i < erases; i++) {
+    scene.shapes.erase(scene.shapes.begin() + 10);
+  }
+}
+
+// Copies are independent scenes, i.e. editing a copy does not change the
+// original. Models with owning pointers copy each shape and instance, and
+// remap the instance pointers to the copied shapes.
+value_model   copy_scene(const value_model& scene) { return scene; }
+packed_model  copy_scene(const packed_model& scene) { return scene; }
+slotmap_model copy_scene(const slotmap_model& scene) { return scene; }
+unique_ptr<unique_model> copy_scene(const unique_ptr<unique_model>& scene) {
+  auto copy   = make_unique<unique_model>();
+  auto shapes = unordered_map<const unique_model::shape*, unique_model::shape*>{};
+  for (auto& shape : scene->shapes) {
+    copy->shapes.push_back(make_unique<unique_model::shape>(*shape));
+    shapes[shape.get()] = copy->shapes.back().get();
+  }
+  for (auto& instance : scene->instances) {
+    copy->instances.push_back(make_unique<unique_model::instance>(*instance));
+    copy->instances.back()->shape = shapes.at(instance->shape);
+  }
+  return copy;
+}
+// Only the scene is copied, shapes and instances are shared with the original
+// and replaced when edited.
+shared_ptr<shared_model> copy_scene(const shared_ptr<shared_model>& scene) {
+  return make_shared<shared_model>(*scene);
+}
+raw_model* copy_scene(const raw_model* scene) {
+  auto copy   = new raw_model{};
+  auto shapes = unordered_map<const raw_model::shape*, raw_model::shape*>{};
+  for (auto shape : scene->shapes) {
+    copy->shapes.push_back(new raw_model::shape{*shape});
+    shapes[shape] = copy->shapes.back();
+  }
+  for (auto instance : scene->instances) {
+    copy->instances.push_back(new raw_model::instance{*instance});
+    copy->instances.back()->shape = shapes.at(instance->shape);
+  }
+  return copy;
+}
+// The copy gets its own arena, sized for the whole scene.
+arena_model copy_scene(const arena_model& scene) {
+  auto& data = *scene.scene;
+  auto  size = sizeof(arena_model::data) +
+              sizeof(arena_model::shape) * data.shapes.size() +
+              sizeof(arena_model::instance) * data.instances.size() + 64;
+  for (auto& shape : data.shapes) {
+    size += sizeof(float3) * (shape.positions.size() + shape.normals.size()) +
+            sizeof(int3) * shape.triangles.size() + shape.name.size() + 64;
+  }
+  auto copy  = arena_model{};
+  copy.arena = make_unique<pmr::monotonic_buffer_resource>(size);
+  auto arena = copy.arena.get();
+  copy.scene = new (arena->allocate(sizeof(arena_model::data),
+      alignof(arena_model::data))) arena_model::data{arena};
+  copy.scene->shapes.reserve(data.shapes.size());
+  copy.scene->instances.reserve(data.instances.size());
+  for (auto& shape : data.shapes) {
+    auto& copied = copy.scene->shapes.emplace_back(arena);
+    copied.name  = shape.name;
+    copied.positions.assign(shape.positions.begin(), shape.positions.end());
+    copied.normals.assign(shape.normals.begin(), shape.normals.end());
+    copied.triangles.assign(shape.triangles.begin(), shape.triangles.end());
+  }
+  for (auto& instance : data.instances) {
+    auto& copied = copy.scene->instances.emplace_back(arena);
+    copied.name  = instance.name;
+    copied.frame = instance.frame;
+    copied.shape = instance.shape;
+  }
+  return copy;
+}
+// Shapes are shared, vertex buffers are copied when edited.
+cow_model copy_scene(const cow_model& scene) { return scene; }
+
+// Moves the positions of the first edits shapes.
+void edit_positions(vector<float3>& positions) {
+  for (auto& pos : positions) pos[0] += 1;
+}
+void edit_shapes(value_model& scene, int edits) {
+  for (auto idx = 0; idx < edits; idx++)
+    edit_positions(scene.shapes[idx].positions);
+}
+void edit_shapes(unique_ptr<unique_model>& scene, int edits) {
+  for (auto idx = 0; idx < edits; idx++)
+    edit_positions(scene->shapes[idx]->positions);
+}
+// Edited shapes are replaced by copies, and so are the instances that refer
+// to them, since both may be shared with other copies of the scene.
+void edit_shapes(shared_ptr<shared_model>& scene, int edits) {
+  auto edited = unordered_map<shared_model::shape*,
+      shared_ptr<shared_model::shape>>{};
+  for (auto idx = 0; idx < edits; idx++) {
+    auto& shape = scene->shapes[idx];
+    auto  copy  = make_shared<shared_model::shape>(*shape);
+    edit_positions(copy->positions);
+    edited[shape.get()] = copy;
+    shape               = copy;
+  }
+  for (auto& instance : scene->instances) {
+    auto it = edited.find(instance->shape.get());
+    if (it == edited.end()) continue;
+    instance        = make_shared<shared_model::instance>(*instance);
+    instance->shape = it->second;
+  }
+}
+void edit_shapes(raw_model* scene, int edits) {
+  for (auto idx = 0; idx < edits; idx++)
+    edit_positions(scene->shapes[idx]->positions);
+}
+void edit_shapes(packed_model& scene, int edits) {
+  for (auto idx = 0; idx < edits; idx++) {
+    auto& range = scene.shapes[idx].positions;
+    for (auto vid = range.start; vid < range.start + range.count; vid++)
+      scene.positions[vid][0] += 1;
+  }
+}
+void edit_shapes(slotmap_model& scene, int edits) {
+  for (auto idx = 0; idx < edits; idx++)
+    edit_positions(scene.shapes.begin()[idx].positions);
+}
+void edit_shapes(arena_model& scene, int edits) {
+  for (auto idx = 0; idx < edits; idx++) {
+    for (auto& pos : scene.scene->shapes[idx].positions) pos[0] += 1;
+  }
+}
+// Buffer for writing, copied first if it is shared.
+template <typename T>
+vector<T>& edit_buffer(cow_model::buffer<T>& buffer) {
+  if (buffer.use_count() > 1) buffer = make_shared<vector<T>>(*buffer);
+  return *buffer;
+}
+// Shape for writing, copied first if it is shared. The copy shares the
+// vertex buffers, that are copied only when written.
+cow_model::shape& edit_shape(cow_model& scene, int idx) {
+  auto& shape = scene.shapes[idx];
+  if (shape.use_count() > 1) shape = make_shared<cow_model::shape>(*shape);
+  return *shape;
+}
+void edit_shapes(cow_model& scene, int edits) {
+  for (auto idx = 0; idx < edits; idx++)
+    edit_positions(edit_buffer(edit_shape(scene, idx).positions));
+}
 
 template <typename any_scene>
 void run_test(const string& message, int vertices, int triangles, int shapes,
-    int instances, int erases) {
-  auto [mem0s, mem1s] = get_used_memory();
-  auto timer          = ::timer{};
+    int instances, int erases, int threads) {
+  reset_peak_memory();
+  auto mem_start = get_used_memory();
+  auto timer     = ::timer{};
   // auto scene          = Scene{};
   // init_scene(scene, vertices, triangles, shapes, instances);
   auto scene          = any_scene{};
-  scene          = make_scene<any_scene>(vertices, triangles, shapes, instances);
-  auto sum            = sum_vertices(scene);
-  auto [mem0e, mem1e] = get_used_memory();
+  scene = make_scene<any_scene>(
+      vertices, triangles, shapes, instances, threads);
+  auto sum        = sum_vertices(scene, threads);
+  auto mem_steady = get_used_memory();
   erase_shapes(scene, erases);
   clear_scene(scene);
   auto elapsed = timer.elapsedfs();
-  printf("%9s %9d %9d %9d %9s %9d %9d %9g\n", message.c_str(), shapes,
-      instances, vertices, elapsed.c_str(), (int)(mem0e - mem0s),
-      (int)(mem1e - mem1s), sum);
+  auto mem_end = get_used_memory();
+  // mem1 is the peak and mem2 the steady-state resident memory of the scene
+  printf("%9s %9d %9d %9d %9d %9s %9d %9d %9d %9d %9g%s\n", message.c_str(),
+      threads, shapes, instances, vertices, elapsed.c_str(),
+      (int)(mem_end.peak - mem_start.resident),
+      (int)(mem_steady.resident - mem_start.resident),
+      (int)(mem_steady.pss - mem_start.pss),
+      (int)(mem_steady.heap - mem_start.heap), sum, timer.countersf().c_str());
+}
+
+// Times copying, moving and snapshotting a scene, after building it. The
+// snapshot is a copy taken before editing the positions of `edits` shapes of
+// the scene, as for undo, and its check is the sum before the edits. Each
+// phase reports its time in ms and its peak memory increase, as mem1.
+template <typename any_scene>
+void run_copy_test(const string& message, int vertices, int triangles,
+    int shapes, int instances, int edits, int threads) {
+  auto scene = make_scene<any_scene>(
+      vertices, triangles, shapes, instances, threads);
+  // the phase ends when this is called, before the check is computed
+  auto end_phase = [&](const char* phase, ::timer& timer,
+                       const memory_usage& mem_start, auto& checked) {
+    auto elapsed  = timer.elapsed() / 1e6;
+    auto counters = timer.countersf();
+    auto mem_end  = get_used_memory();
+    auto sum      = sum_vertices(checked, threads);
+    printf("%9s %9s %9d %9d %9d %9d %9.1f %9d %9d %9g%s\n", message.c_str(),
+        phase, threads, shapes, instances, vertices, elapsed,
+        (int)(mem_end.peak - mem_start.resident),
+        (int)(mem_end.heap - mem_start.heap), sum, counters.c_str());
+  };
+  {
+    reset_peak_memory();
+    auto mem_start = get_used_memory();
+    auto timer     = ::timer{};
+    auto copy      = copy_scene(scene);
+    end_phase("copy", timer, mem_start, copy);
+    clear_scene(copy);
+  }
+  {
+    reset_peak_memory();
+    auto mem_start = get_used_memory();
+    auto timer     = ::timer{};
+    auto moved     = std::move(scene);
+    scene          = std::move(moved);
+    end_phase("move", timer, mem_start, scene);
+  }
+  {
+    reset_peak_memory();
+    auto mem_start = get_used_memory();
+    auto timer     = ::timer{};
+    auto snapshot  = copy_scene(scene);
+    edit_shapes(scene, edits);
+    end_phase("snapshot", timer, mem_start, snapshot);
+    clear_scene(snapshot);
+  }
+  clear_scene(scene);
+}
+
+// Times clearing a scene synchronously, or with a background or incremental
+// reclaimer. The pause is the time the caller is blocked in clear_scene, the
+// tick the longest incremental tick, the reclaim the time spent destroying
+// the scene and the total the time until it is all freed, in ms. Incremental
+// ticks run back to back, as if each frame did nothing else.
+template <typename any_scene>
+void run_reclaim_test(const string& message, int vertices, int triangles,
+    int shapes, int instances, int threads) {
+  // built before the timers, like a long-lived reclaimer, so that the pause
+  // does not include starting the background thread
+  auto background  = ::reclaimer{reclaimer::policy::background};
+  auto incremental = ::reclaimer{reclaimer::policy::incremental};
+  for (auto policy : {"sync", "background", "incremental"}) {
+    auto scene = make_scene<any_scene>(
+        vertices, triangles, shapes, instances, threads);
+    auto sum   = sum_vertices(scene, threads);
+    auto pause = (int64_t)0, tick = (int64_t)0, reclaim = (int64_t)0;
+    auto timer = ::timer{};
+    if (policy == string{"sync"}) {
+      clear_scene(scene);
+      pause = reclaim = timer.elapsed();
+    } else {
+      auto& reclaimer =
+          policy == string{"background"} ? background : incremental;
+      clear_scene(scene, reclaimer);
+      pause = timer.elapsed();
+      reclaimer.wait();
+      tick    = reclaimer.max_tick_time();
+      reclaim = reclaimer.reclaim_time();
+    }
+    auto total = timer.elapsed();
+    printf("%9s %11s %9d %9d %9d %9d %9.1f %9.1f %9.1f %9.1f %9g%s\n",
+        message.c_str(), policy, threads, shapes, instances, vertices,
+        pause / 1e6, tick / 1e6, reclaim / 1e6, total / 1e6, sum,
+        timer.countersf().c_str());
+  }
+}
+
+vector<int> get_thread_counts(int max_threads) {
+  auto thread_counts = vector<int>{};
+  for (auto count = 1; count < max_threads; count *= 2) {
+    thread_counts.push_back(count);
+  }
+  thread_counts.push_back(max_threads);
+  return thread_counts;
+}
+
+int get_option(int argc, const char** argv, const string& name, int def) {
+  for (auto i = 1; i + 1 < argc; i++) {
+    if (argv[i] == name) return atoi(argv[i + 1]);
+  }
+  return def;
+}
+
+// Returns the string value following `--name` on the command line, or def.
+string get_option(
+    int argc, const char** argv, const string& name, const string& def) {
+  for (auto i = 1; i + 1 < argc; i++) {
+    if (argv[i] == name) return argv[i + 1];
+  }
+  return def;
 }
 
 int main(int argc, const char** argv) {
-  printf("%9s %9s %9s %9s %9s %9s %9s %9s\n", "mode", "shapes", "instances",
-      "vertices", "time", "mem1", "mem2", "check");
-  for (auto shapes : {5000, 15000}) {
-    for (auto instance_ratio : {1, 5}) {
-      for (auto vertices : {50000}) {
-        for (auto triangles : {50000}) {
+  perf_counters::parse_args(argc, argv);
+  auto max_threads = get_option(argc, argv, "--threads",
+      max((int)std::thread::hardware_concurrency(), 1));
+  auto test = get_option(argc, argv, "--test", "all");  // clear|copy|reclaim|all
+  auto vertices = get_option(argc, argv, "--vertices", 50000);
+  auto triangles = vertices;
+  if (test == "clear" || test == "all") {
+    printf("%9s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n", "mode", "threads",
+        "shapes", "instances", "vertices", "time", "mem1", "mem2", "pss",
+        "heap", "check");
+    for (auto shapes : {5000, 15000}) {
+      for (auto instance_ratio : {1, 5}) {
+        for (auto threads : get_thread_counts(max_threads)) {
+          auto instances = shapes * instance_ratio, erases = shapes / 100;
           run_test<value_model>("value", vertices, triangles, shapes,
-              shapes * instance_ratio, shapes / 100);
+              instances, erases, threads);
           run_test<unique_ptr<unique_model>>("unique", vertices, triangles,
-              shapes, shapes * instance_ratio, shapes / 100);
+              shapes, instances, erases, threads);
           run_test<shared_ptr<shared_model>>("shared", vertices, triangles,
-              shapes, shapes * instance_ratio, shapes / 100);
-          run_test<raw_model*>("raw", vertices, triangles, shapes,
-              shapes * instance_ratio, shapes / 100);
+              shapes, instances, erases, threads);
+          run_test<raw_model*>("raw", vertices, triangles, shapes, instances,
+              erases, threads);
+          run_test<packed_model>("packed", vertices, triangles, shapes,
+              instances, erases, threads);
+          run_test<slotmap_model>("slotmap", vertices, triangles, shapes,
+              instances, erases, threads);
+          run_test<arena_model>("arena", vertices, triangles, shapes,
+              instances, erases, threads);
+          run_test<cow_model>("cow", vertices, triangles, shapes, instances,
+              erases, threads);
         }
       }
     }
   }
+  if (test == "copy" || test == "all") {
+    // phases are single-threaded, scenes are built and summed on all threads
+    printf("%9s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n", "mode", "phase",
+        "threads", "shapes", "instances", "vertices", "ms", "mem1", "heap",
+        "check");
+    for (auto shapes : {5000, 15000}) {
+      for (auto instance_ratio : {1, 5}) {
+        auto instances = shapes * instance_ratio, edits = shapes / 100;
+        auto threads   = max_threads;
+        run_copy_test<value_model>("value", vertices, triangles, shapes,
+            instances, edits, threads);
+        run_copy_test<unique_ptr<unique_model>>("unique", vertices, triangles,
+            shapes, instances, edits, threads);
+        run_copy_test<shared_ptr<shared_model>>("shared", vertices, triangles,
+            shapes, instances, edits, threads);
+        run_copy_test<raw_model*>("raw", vertices, triangles, shapes,
+            instances, edits, threads);
+        run_copy_test<packed_model>("packed", vertices, triangles, shapes,
+            instances, edits, threads);
+        run_copy_test<slotmap_model>("slotmap", vertices, triangles, shapes,
+            instances, edits, threads);
+        run_copy_test<arena_model>("arena", vertices, triangles, shapes,
+            instances, edits, threads);
+        run_copy_test<cow_model>("cow", vertices, triangles, shapes,
+            instances, edits, threads);
+      }
+    }
+  }
+  if (test == "reclaim" || test == "all") {
+    printf("%9s %11s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n", "mode", "reclaim",
+        "threads", "shapes", "instances", "vertices", "pause", "tick",
+        "reclaim", "total", "check");
+    for (auto shapes : {5000, 15000}) {
+      for (auto instance_ratio : {1, 5}) {
+        auto instances = shapes * instance_ratio, threads = max_threads;
+        run_reclaim_test<value_model>(
+            "value", vertices, triangles, shapes, instances, threads);
+        run_reclaim_test<unique_ptr<unique_model>>(
+            "unique", vertices, triangles, shapes, instances, threads);
+        run_reclaim_test<shared_ptr<shared_model>>(
+            "shared", vertices, triangles, shapes, instances, threads);
+        run_reclaim_test<raw_model*>(
+            "raw", vertices, triangles, shapes, instances, threads);
+        run_reclaim_test<packed_model>(
+            "packed", vertices, triangles, shapes, instances, threads);
+        run_reclaim_test<slotmap_model>(
+            "slotmap", vertices, triangles, shapes, instances, threads);
+        run_reclaim_test<arena_model>(
+            "arena", vertices, triangles, shapes, instances, threads);
+        run_reclaim_test<cow_model>(
+            "cow", vertices, triangles, shapes, instances, threads);
+      }
+    }
+  }
 }